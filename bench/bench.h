@@ -0,0 +1,149 @@
+#ifndef PIPE_BENCH_H
+#define PIPE_BENCH_H
+
+// Helpers shared by the benchmarks.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined __i386__ || defined __x86_64__
+#		include <immintrin.h>
+#endif
+
+/// Monotonic time in nanoseconds.
+static inline uint64_t
+tsBenchNow(void)
+{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/// Sleep for "milliseconds".
+static inline void
+tsBenchSleep(uint32_t milliseconds)
+{
+		struct timespec ts;
+		ts.tv_sec = milliseconds / 1000;
+		ts.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+		nanosleep(&ts, NULL);
+}
+
+/// Back off a little after a failed attempt.
+static inline void
+tsBenchPause(void)
+{
+#if defined __i386__ || defined __x86_64__
+		_mm_pause();
+#endif
+}
+
+/// Raw ticks of the cheapest clock there is, the time stamp counter on x86. Convert them
+/// with "tsBenchTicksPerNs".
+static inline uint64_t
+tsBenchTicks(void)
+{
+#if defined __i386__ || defined __x86_64__
+		// Keep earlier instructions from drifting past the read.
+		_mm_lfence();
+		return __rdtsc();
+#else
+		return tsBenchNow();
+#endif
+}
+
+/// Ticks of "tsBenchTicks" per nanosecond, measured against the monotonic clock.
+static inline double
+tsBenchTicksPerNs(void)
+{
+#if defined __i386__ || defined __x86_64__
+		uint64_t startNs = tsBenchNow();
+		uint64_t startTicks = tsBenchTicks();
+		tsBenchSleep(100);
+		uint64_t ticks = tsBenchTicks() - startTicks;
+		return (double)ticks / (double)(tsBenchNow() - startNs);
+#else
+		return 1.0;
+#endif
+}
+
+/// Start "readers" threads running "reader" and one running "writer", let them run for
+/// "milliseconds", then raise "*stop" and wait for all of them. Return the nanoseconds
+/// between starting the writer and it having stopped.
+static inline uint64_t
+tsBenchRunThreads(void *(*writer)(void *),
+    void *(*reader)(void *),
+    uint32_t readers,
+    uint32_t milliseconds,
+    uint32_t volatile *stop)
+{
+		pthread_t writerThread;
+		pthread_t *readerThreads = (pthread_t *)malloc((readers + 1) * sizeof(pthread_t));
+		uint64_t start;
+		uint64_t elapsed;
+
+		__atomic_store_n(stop, 0, __ATOMIC_RELAXED);
+		for (uint32_t i = 0; i < readers; ++i)
+		{
+				pthread_create(&readerThreads[i], NULL, reader, (void *)(uintptr_t)i);
+		}
+		start = tsBenchNow();
+		pthread_create(&writerThread, NULL, writer, NULL);
+		tsBenchSleep(milliseconds);
+		__atomic_store_n(stop, 1, __ATOMIC_RELAXED);
+		pthread_join(writerThread, NULL);
+		elapsed = tsBenchNow() - start;
+		for (uint32_t i = 0; i < readers; ++i) pthread_join(readerThreads[i], NULL);
+		free(readerThreads);
+
+		return elapsed;
+}
+
+/// Keep the compiler from optimizing "value" away.
+#define TS_BENCH_KEEP(value) __asm__ volatile("" : : "g"(value) : "memory")
+
+/// Define "static double name(pipes, rounds, begin, end)", returning the nanoseconds per
+/// round of one push and one steal, "rounds" times, on pipes of type "Pipe" picked at
+/// random among "pipes" half full ones. That is how a worker among many others touches
+/// their pipes, so what counts is how much of all of them fits in the caches. Pipes are set
+/// up with "init(pipe)", "push(pipe, value)" and "steal(pipe, &value)" take a "uint64_t".
+/// "begin" and "end", unless NULL, are called right before and after the timed part. Needs
+/// "pipe.h" for "TS_PIPE_SIZE" and "TS_PIPE_CACHE_LINE_SIZE".
+#define TS_BENCH_RANDOM_PIPES_DEFINE(name, Pipe, init, push, steal) \
+		static double name( \
+		    uint32_t pipes, uint32_t rounds, void (*begin)(void), void (*end)(void)) \
+		{ \
+				Pipe *all = (Pipe *)aligned_alloc(TS_PIPE_CACHE_LINE_SIZE, pipes * sizeof(Pipe)); \
+				uint64_t random = 0x9E3779B97F4A7C15ull; \
+				uint64_t sum = 0; \
+				uint64_t start; \
+				if (!all) abort(); \
+				for (uint32_t p = 0; p < pipes; ++p) \
+				{ \
+						init(&all[p]); \
+						for (uint64_t i = 0; i < TS_PIPE_SIZE / 2; ++i) push(&all[p], i); \
+				} \
+				/* Every pipe gets as many pushes as steals on average, the odd one full or empty \
+				   costs about what a success does. */ \
+				if (begin) begin(); \
+				start = tsBenchNow(); \
+				for (uint32_t n = 0; n < rounds; ++n) \
+				{ \
+						uint64_t value; \
+						random ^= random << 13; \
+						random ^= random >> 7; \
+						random ^= random << 17; \
+						push(&all[(uint32_t)random % pipes], (uint64_t)n); \
+						if (steal(&all[(uint32_t)(random >> 32) % pipes], &value)) sum += value; \
+				} \
+				start = tsBenchNow() - start; \
+				if (end) end(); \
+				TS_BENCH_KEEP(sum); \
+				free(all); \
+				return (double)start / rounds; \
+		}
+
+#endif // PIPE_BENCH_H
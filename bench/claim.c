@@ -0,0 +1,122 @@
+// Reading 512 byte payloads: "ReaderTryReadBack", which copies every element out of the
+// pipe before it is looked at, against "ReaderClaimBack" and "ReaderReleaseBack", which
+// look at it in its slot, once as is and once also asking "ReaderClaimExpired" whether the
+// writer needs the slot back. One thread fills the pipe and then drains it, only the
+// draining is timed. All of them sum the same words, the exit status is 1 if the sums
+// differ.
+//
+// Usage: pipe_bench_claim [rounds]
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 8,
+		BENCH_PIPE_SIZE = 1 << BENCH_PIPE_SIZE_LOG2
+};
+
+struct BenchPayload
+{
+		uint64_t words[64];
+};
+
+typedef struct BenchPayload BenchPayload;
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, BenchPayload, BENCH_PIPE_SIZE_LOG2)
+
+static TSbenchpipe benchPipe;
+
+/// What the reader does with a payload, reading a few of its words.
+static inline uint64_t
+benchProcess(const BenchPayload *payload)
+{
+		return payload->words[0] + payload->words[17] + payload->words[63];
+}
+
+/// Nanoseconds per element read with "mode" (0 copy, 1 claim, 2 claim and check for
+/// expiry), store the sum of what was read in "*sum" and the expired claims in "*expired".
+static double
+benchRun(int mode, uint64_t rounds, uint64_t *sum, uint64_t *expired)
+{
+		uint64_t elapsed = 0;
+		*sum = 0;
+		*expired = 0;
+		tsBenchPipeInit(&benchPipe);
+
+		for (uint64_t round = 0; round < rounds; ++round)
+		{
+				for (uint32_t i = 0; i < BENCH_PIPE_SIZE; ++i)
+				{
+						BenchPayload *payload = tsBenchPipeWriterReserveFront(&benchPipe);
+						for (uint32_t w = 0; w < 64; ++w) payload->words[w] = round + i + w;
+						tsBenchPipeWriterCommitFront(&benchPipe);
+				}
+
+				uint64_t start = tsBenchNow();
+				if (mode == 0)
+				{
+						BenchPayload payload;
+						while (tsBenchPipeReaderTryReadBack(&benchPipe, &payload))
+						{
+								*sum += benchProcess(&payload);
+						}
+				}
+				else
+				{
+						uint32_t slot;
+						const BenchPayload *payload;
+						while ((payload = tsBenchPipeReaderClaimBack(&benchPipe, &slot)))
+						{
+								// The pipe starts out full, so early claims are expired. Finish them from a
+								// copy like a reader with more to do than this would.
+								if (mode == 2 && tsBenchPipeReaderClaimExpired(&benchPipe, slot))
+								{
+										BenchPayload copy;
+										tsBenchPipeReaderDetachBack(&benchPipe, slot, &copy);
+										*sum += benchProcess(&copy);
+										++*expired;
+										continue;
+								}
+								*sum += benchProcess(payload);
+								tsBenchPipeReaderReleaseBack(&benchPipe, slot);
+						}
+				}
+				elapsed += tsBenchNow() - start;
+		}
+		return (double)elapsed / ((double)rounds * BENCH_PIPE_SIZE);
+}
+
+int
+main(int argc, char **argv)
+{
+		static const char *const names[] = {"copy", "claim", "claim, checking expiry"};
+		uint64_t rounds = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+		uint64_t sums[3], expired[3];
+		double ns[3] = {1e300, 1e300, 1e300};
+
+		// Best of a few runs, the first one also warms the caches up.
+		for (int run = 0; run < 5; ++run)
+		{
+				for (int mode = 0; mode < 3; ++mode)
+				{
+						double runNs = benchRun(mode, rounds, &sums[mode], &expired[mode]);
+						if (runNs < ns[mode]) ns[mode] = runNs;
+				}
+		}
+
+		int ok = sums[0] == sums[1] && sums[0] == sums[2];
+		printf("%zu byte payloads, per element read%s\n", sizeof(BenchPayload),
+		    ok ? "" : "  WRONG SUM");
+		for (int mode = 0; mode < 3; ++mode)
+		{
+				printf("%-24s %7.2f ns (%.2fx)", names[mode], ns[mode], ns[0] / ns[mode]);
+				if (mode == 2)
+				{
+						printf(", %.1f%% of claims expired",
+						    100.0 * (double)expired[mode] / ((double)rounds * BENCH_PIPE_SIZE));
+				}
+				printf("\n");
+		}
+		return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+// Many pipes hot at once, built once with 32-bit flags and once with
+// "TS_PIPE_COMPACT_FLAGS", and driven by "footprint_main.c". A single thread pushes to
+// and steals from pipes picked at random, see "TS_BENCH_RANDOM_PIPES_DEFINE".
+
+#include "./bench.h"
+#include "../pipe.h"
+
+#ifdef TS_PIPE_COMPACT_FLAGS
+#		define BENCH_FOOTPRINT_RUN  benchFootprintCompact
+#		define BENCH_FOOTPRINT_SIZE benchFootprintSizeCompact
+#else
+#		define BENCH_FOOTPRINT_RUN  benchFootprintWide
+#		define BENCH_FOOTPRINT_SIZE benchFootprintSizeWide
+#endif
+
+/// Bytes every pipe takes.
+size_t
+BENCH_FOOTPRINT_SIZE(void)
+{
+		return sizeof(TSpipe);
+}
+
+static inline int
+benchFootprintPush(TSpipe *pipe, uint64_t value)
+{
+		TSpipedata data = (TSpipedata)value;
+		return tsPipeWriterTryWriteFront(pipe, &data);
+}
+
+static inline int
+benchFootprintSteal(TSpipe *pipe, uint64_t *value)
+{
+		TSpipedata data;
+		if (!tsPipeReaderTryReadBack(pipe, &data)) return 0;
+		*value = data;
+		return 1;
+}
+
+TS_BENCH_RANDOM_PIPES_DEFINE(
+    benchFootprintRandom, TSpipe, tsPipeInit, benchFootprintPush, benchFootprintSteal)
+
+/// Nanoseconds per push and steal over "pipes" half full pipes, "rounds" of each. "begin"
+/// is called once the pipes are set up and right before the timed part, "end" right after.
+double
+BENCH_FOOTPRINT_RUN(uint32_t pipes, uint32_t rounds, void (*begin)(void), void (*end)(void))
+{
+		return benchFootprintRandom(pipes, rounds, begin, end);
+}
@@ -0,0 +1,119 @@
+// Pipes with 32-bit flags against "TS_PIPE_COMPACT_FLAGS" when hundreds of them are hot:
+// bytes per pipe, then for 64 to "max pipes" pipes the nanoseconds per push and steal and,
+// where the kernel lets us count them, L1 data and last level cache misses per round.
+//
+// Usage: pipe_bench_footprint [max pipes] [rounds per run]
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "./bench.h"
+
+size_t benchFootprintSizeWide(void);
+size_t benchFootprintSizeCompact(void);
+double benchFootprintWide(uint32_t pipes, uint32_t rounds, void (*begin)(void),
+    void (*end)(void));
+double benchFootprintCompact(uint32_t pipes, uint32_t rounds, void (*begin)(void),
+    void (*end)(void));
+
+enum
+{
+		BENCH_COUNTER_L1D,
+		BENCH_COUNTER_LLC,
+		BENCH_COUNTERS
+};
+
+static int benchCounters[BENCH_COUNTERS] = {-1, -1};
+static uint64_t benchCounts[BENCH_COUNTERS];
+
+/// Open a counter of read misses of "cache" for this thread, -1 if there is none.
+static int
+benchOpenCounter(uint64_t cache)
+{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.size = sizeof(attr);
+		attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+benchCountersBegin(void)
+{
+		for (int c = 0; c < BENCH_COUNTERS; ++c)
+		{
+				if (benchCounters[c] < 0) continue;
+				ioctl(benchCounters[c], PERF_EVENT_IOC_RESET, 0);
+				ioctl(benchCounters[c], PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+static void
+benchCountersEnd(void)
+{
+		for (int c = 0; c < BENCH_COUNTERS; ++c)
+		{
+				if (benchCounters[c] < 0) continue;
+				ioctl(benchCounters[c], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(benchCounters[c], &benchCounts[c], sizeof(uint64_t)) != sizeof(uint64_t))
+				{
+						benchCounts[c] = 0;
+				}
+		}
+}
+
+/// Print the misses per round counted by "benchCountersEnd", or "n/a".
+static void
+benchPrintMisses(uint32_t rounds)
+{
+		for (int c = 0; c < BENCH_COUNTERS; ++c)
+		{
+				if (benchCounters[c] < 0) printf(" %9s", "n/a");
+				else printf(" %9.3f", (double)benchCounts[c] / rounds);
+		}
+}
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxPipes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 4096;
+		uint32_t rounds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 4000000;
+
+		benchCounters[BENCH_COUNTER_L1D] = benchOpenCounter(PERF_COUNT_HW_CACHE_L1D);
+		benchCounters[BENCH_COUNTER_LLC] = benchOpenCounter(PERF_COUNT_HW_CACHE_LL);
+		if (benchCounters[BENCH_COUNTER_L1D] < 0 && benchCounters[BENCH_COUNTER_LLC] < 0)
+		{
+				printf("no cache miss counters here, see perf_event_paranoid\n");
+		}
+
+		size_t wide = benchFootprintSizeWide();
+		size_t compact = benchFootprintSizeCompact();
+		printf("bytes per pipe: %zu with 32-bit flags, %zu with compact flags (%.0f%% less)\n\n",
+		    wide, compact, 100.0 * (double)(wide - compact) / (double)wide);
+
+		printf("%6s %10s %10s %9s %9s | %10s %10s %9s %9s  %6s\n", "pipes", "wide KB",
+		    "ns/round", "L1D miss", "LLC miss", "compact KB", "ns/round", "L1D miss", "LLC miss",
+		    "gain");
+		for (uint32_t pipes = 64; pipes <= maxPipes; pipes *= 2)
+		{
+				double wideNs =
+				    benchFootprintWide(pipes, rounds, benchCountersBegin, benchCountersEnd);
+				printf("%6u %10zu %10.2f", pipes, pipes * wide / 1024, wideNs);
+				benchPrintMisses(rounds);
+
+				double compactNs =
+				    benchFootprintCompact(pipes, rounds, benchCountersBegin, benchCountersEnd);
+				printf(" | %10zu %10.2f", pipes * compact / 1024, compactNs);
+				benchPrintMisses(rounds);
+				printf("  %5.2fx\n", wideNs / compactNs);
+		}
+		return 0;
+}
@@ -0,0 +1,57 @@
+// One writer against "readers" thieves on a "TSpipe", built once per index layout (see
+// "TS_PIPE_ISOLATE_INDICES") and driven by "indices_main.c".
+
+#include "./bench.h"
+#include "../pipe.h"
+
+#ifdef TS_PIPE_ISOLATE_INDICES
+#		define BENCH_INDICES_RUN benchIndicesIsolated
+#else
+#		define BENCH_INDICES_RUN benchIndicesShared
+#endif
+
+static TSpipe benchPipe;
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+static void *
+benchWriter(void *arg)
+{
+		TSpipedata value = 0;
+		uint64_t written = 0;
+		(void)arg;
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				if (tsPipeWriterTryWriteFront(&benchPipe, &value))
+				{
+						++value;
+						++written;
+				}
+				else { tsBenchPause(); }
+		}
+		benchWritten = written;
+		return NULL;
+}
+
+static void *
+benchReader(void *arg)
+{
+		TSpipedata value;
+		(void)arg;
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				if (tsPipeReaderTryReadBack(&benchPipe, &value)) { TS_BENCH_KEEP(value); }
+				else { tsBenchPause(); }
+		}
+		return NULL;
+}
+
+/// Run for "milliseconds" and return the elements passed through the pipe per second.
+double
+BENCH_INDICES_RUN(uint32_t readers, uint32_t milliseconds)
+{
+		uint64_t elapsed;
+		tsPipeInit(&benchPipe);
+		elapsed = tsBenchRunThreads(benchWriter, benchReader, readers, milliseconds, &benchStop);
+		return (double)benchWritten * 1e9 / (double)elapsed;
+}
@@ -0,0 +1,26 @@
+// Throughput of 1 writer and 1 to "max readers" thieves with the indices sharing a cache
+// line against each of them on a line of its own ("TS_PIPE_ISOLATE_INDICES").
+//
+// Usage: pipe_bench_indices [max readers] [milliseconds per run]
+
+#include "./bench.h"
+
+double benchIndicesShared(uint32_t readers, uint32_t milliseconds);
+double benchIndicesIsolated(uint32_t readers, uint32_t milliseconds);
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 32;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+
+		printf("%8s %20s %20s %8s\n", "readers", "shared (Mitems/s)", "isolated (Mitems/s)", "gain");
+		for (uint32_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+				double shared = benchIndicesShared(readers, milliseconds);
+				double isolated = benchIndicesIsolated(readers, milliseconds);
+				printf("%8u %20.2f %20.2f %7.2fx\n", readers, shared / 1e6, isolated / 1e6,
+				    isolated / shared);
+		}
+		return 0;
+}
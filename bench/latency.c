@@ -0,0 +1,192 @@
+// Hand-off latency of the default pipe: how long an element sits between the writer's
+// "tsPipeWriterTryWriteFront" and a reader's successful "tsPipeReaderTryReadBack". The
+// writer stamps every element with the time stamp counter right before pushing it at a
+// fixed rate, every reader records what it sees in a log-linear (HDR-style) histogram.
+//
+// Usage: pipe_bench_latency [readers] [elements per second, 0 for flat out] [seconds]
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 10,
+
+		/// Every power of two range of the histogram is split in "1 << BENCH_HISTOGRAM_BITS"
+		/// linear buckets, so a value is off by at most 1 / 32 of it.
+		BENCH_HISTOGRAM_BITS = 5,
+		BENCH_HISTOGRAM_BUCKETS = 64 << BENCH_HISTOGRAM_BITS
+};
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, uint64_t, BENCH_PIPE_SIZE_LOG2)
+
+struct BenchHistogram
+{
+		uint64_t counts[BENCH_HISTOGRAM_BUCKETS];
+		uint64_t total;
+		uint64_t max;
+} __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE)));
+
+static inline uint32_t
+benchHistogramBucket(uint64_t value)
+{
+		if (value < (1u << BENCH_HISTOGRAM_BITS)) return (uint32_t)value;
+		uint32_t exponent = 63 - (uint32_t)__builtin_clzll(value);
+		uint32_t shift = exponent - BENCH_HISTOGRAM_BITS;
+		return ((shift + 1) << BENCH_HISTOGRAM_BITS) +
+		    (uint32_t)(value >> shift) - (1u << BENCH_HISTOGRAM_BITS);
+}
+
+/// Largest value that falls into "bucket".
+static inline uint64_t
+benchHistogramValue(uint32_t bucket)
+{
+		if (bucket < (1u << BENCH_HISTOGRAM_BITS)) return bucket;
+		uint32_t shift = (bucket >> BENCH_HISTOGRAM_BITS) - 1;
+		uint64_t sub = bucket & ((1u << BENCH_HISTOGRAM_BITS) - 1);
+		return (((1u << BENCH_HISTOGRAM_BITS) + sub + 1) << shift) - 1;
+}
+
+static inline void
+benchHistogramRecord(struct BenchHistogram *histogram, uint64_t value)
+{
+		++histogram->counts[benchHistogramBucket(value)];
+		++histogram->total;
+		if (value > histogram->max) histogram->max = value;
+}
+
+static void
+benchHistogramMerge(struct BenchHistogram *into, const struct BenchHistogram *from)
+{
+		for (uint32_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; ++i) into->counts[i] += from->counts[i];
+		into->total += from->total;
+		if (from->max > into->max) into->max = from->max;
+}
+
+/// Smallest recorded value that "percentile" percent of all values do not exceed.
+static uint64_t
+benchHistogramPercentile(const struct BenchHistogram *histogram, double percentile)
+{
+		uint64_t rank = (uint64_t)((double)histogram->total * percentile / 100.0 + 0.5);
+		uint64_t seen = 0;
+		if (rank == 0) rank = 1;
+		for (uint32_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; ++i)
+		{
+				seen += histogram->counts[i];
+				if (seen >= rank)
+				{
+						uint64_t value = benchHistogramValue(i);
+						return value < histogram->max ? value : histogram->max;
+				}
+		}
+		return histogram->max;
+}
+
+static TSbenchpipe benchPipe;
+static uint32_t volatile benchStop;
+static struct BenchHistogram *benchHistograms;
+static uint64_t benchRate;
+static uint64_t benchWritten;
+static uint64_t benchFull;
+static double benchTicksPerNs;
+
+static void *
+benchWriter(void *arg)
+{
+		uint64_t written = 0;
+		uint64_t full = 0;
+		uint64_t period = benchRate ? (uint64_t)(benchTicksPerNs * 1e9 / (double)benchRate) : 0;
+		uint64_t next = tsBenchTicks();
+		(void)arg;
+
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				if (period)
+				{
+						// Spin rather than sleep, sleeping is far coarser than the periods we want.
+						if (tsBenchTicks() < next) continue;
+						next += period;
+				}
+
+				// Stamp every attempt anew, a full pipe is the writer's wait and not latency.
+				uint64_t stamp = tsBenchTicks();
+				int success;
+				while (!(success = tsBenchPipeWriterTryWriteFront(&benchPipe, &stamp)) &&
+				    !tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+				{
+						++full;
+						stamp = tsBenchTicks();
+				}
+				written += success;
+		}
+		benchWritten = written;
+		benchFull = full;
+		return NULL;
+}
+
+static void *
+benchReader(void *arg)
+{
+		struct BenchHistogram *histogram = &benchHistograms[(uintptr_t)arg];
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				uint64_t stamp;
+				if (tsBenchPipeReaderTryReadBack(&benchPipe, &stamp))
+				{
+						uint64_t ticks = tsBenchTicks() - stamp;
+						benchHistogramRecord(histogram, (uint64_t)((double)ticks / benchTicksPerNs));
+				}
+				else { tsBenchPause(); }
+		}
+		return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+		static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+		uint32_t readers = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1;
+		uint32_t seconds = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 2;
+		benchRate = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+		if (readers == 0) readers = 1;
+
+		benchTicksPerNs = tsBenchTicksPerNs();
+		benchHistograms = (struct BenchHistogram *)aligned_alloc(
+		    __alignof__(struct BenchHistogram), readers * sizeof(struct BenchHistogram));
+		memset(benchHistograms, 0, readers * sizeof(struct BenchHistogram));
+		tsBenchPipeInit(&benchPipe);
+
+		tsBenchRunThreads(benchWriter, benchReader, readers, seconds * 1000, &benchStop);
+
+		struct BenchHistogram all;
+		memset(&all, 0, sizeof(all));
+		for (uint32_t r = 0; r < readers; ++r) benchHistogramMerge(&all, &benchHistograms[r]);
+
+		printf("%u readers, %llu elements/s asked, %.0f written/s, %llu times full, "
+		    "%.3f ticks/ns\n",
+		    readers, (unsigned long long)benchRate, (double)benchWritten / seconds,
+		    (unsigned long long)benchFull, benchTicksPerNs);
+		printf("%8s %10s", "reader", "count");
+		for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p)
+		{
+				printf(" %8g%%", percentiles[p]);
+		}
+		printf(" %9s   (ns)\n", "max");
+
+		for (uint32_t r = 0; r <= readers; ++r)
+		{
+				const struct BenchHistogram *histogram = r < readers ? &benchHistograms[r] : &all;
+				if (r < readers) printf("%8u", r);
+				else printf("%8s", "all");
+				printf(" %10llu", (unsigned long long)histogram->total);
+				for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p)
+				{
+						printf(" %9llu",
+						    (unsigned long long)benchHistogramPercentile(histogram, percentiles[p]));
+				}
+				printf(" %9llu\n", (unsigned long long)histogram->max);
+		}
+
+		free(benchHistograms);
+		return 0;
+}
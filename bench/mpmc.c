@@ -0,0 +1,162 @@
+// "TSmpmcqueue" against what it replaces: a pipe whose writer side is serialized by a
+// mutex so that several producers can share it, while consumers read lock-free as usual.
+// Every producer enqueues its share of the elements, consumers take them until all are
+// through; the sum of what came out is checked, the exit status is 1 if any is wrong.
+//
+// Usage: pipe_bench_mpmc [elements] [max producers] [max consumers]
+
+#include <sched.h>
+
+#include "./bench.h"
+#include "../pipe_mpmc.h"
+
+enum
+{
+		BENCH_QUEUE_SIZE_LOG2 = 10
+};
+
+TS_MPMC_QUEUE_DEFINE(TSbenchqueue, tsBenchQueue, uint64_t, BENCH_QUEUE_SIZE_LOG2)
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, uint64_t, BENCH_QUEUE_SIZE_LOG2)
+
+static TSbenchqueue benchQueue;
+static TSbenchpipe benchPipe;
+static pthread_mutex_t benchLock = PTHREAD_MUTEX_INITIALIZER;
+static int benchLocked;
+static uint64_t benchPerProducer;
+static uint64_t volatile benchTaken;
+static uint64_t volatile benchSum;
+static uint64_t benchTotal;
+
+/// Wait for the other side, giving the core away now and then in case it needs it.
+static inline void
+benchBackoff(uint32_t *failures)
+{
+		if (++*failures & 63) tsBenchPause();
+		else sched_yield();
+}
+
+static void *
+benchProducer(void *arg)
+{
+		uint32_t failures = 0;
+		uint64_t first = (uint64_t)(uintptr_t)arg * benchPerProducer + 1;
+		for (uint64_t value = first; value < first + benchPerProducer; ++value)
+		{
+				if (benchLocked)
+				{
+						int written;
+						do
+						{
+								pthread_mutex_lock(&benchLock);
+								written = tsBenchPipeWriterTryWriteFront(&benchPipe, &value);
+								pthread_mutex_unlock(&benchLock);
+								if (!written) benchBackoff(&failures);
+						} while (!written);
+				}
+				else
+				{
+						while (!tsBenchQueueTryEnqueue(&benchQueue, &value)) benchBackoff(&failures);
+				}
+		}
+		return NULL;
+}
+
+static void *
+benchConsumer(void *arg)
+{
+		uint64_t sum = 0;
+		uint64_t taken = 0;
+		uint32_t failures = 0;
+		(void)arg;
+
+		while (__atomic_load_n(&benchTaken, __ATOMIC_RELAXED) < benchTotal)
+		{
+				uint64_t value;
+				int read = benchLocked ? tsBenchPipeReaderTryReadBack(&benchPipe, &value) :
+														    tsBenchQueueTryDequeue(&benchQueue, &value);
+				if (read)
+				{
+						sum += value;
+						++taken;
+
+						// Publish in batches, every consumer bumping one counter per element would
+						// measure that counter more than the queue.
+						if ((taken & 255) == 0)
+						{
+								__atomic_fetch_add(&benchTaken, 256, __ATOMIC_RELAXED);
+								taken = 0;
+						}
+				}
+				else
+				{
+						if (taken)
+						{
+								__atomic_fetch_add(&benchTaken, taken, __ATOMIC_RELAXED);
+								taken = 0;
+						}
+						benchBackoff(&failures);
+				}
+		}
+		__atomic_fetch_add(&benchTaken, taken, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&benchSum, sum, __ATOMIC_RELAXED);
+		return NULL;
+}
+
+/// Move "elements" through the queue, return the elapsed nanoseconds and store whether the
+/// sum came out right in "*ok".
+static uint64_t
+benchRun(int locked, uint32_t producers, uint32_t consumers, uint64_t elements, int *ok)
+{
+		pthread_t *threads = (pthread_t *)malloc((producers + consumers) * sizeof(pthread_t));
+		benchLocked = locked;
+		benchPerProducer = elements / producers;
+		benchTotal = benchPerProducer * producers;
+		benchTaken = 0;
+		benchSum = 0;
+		tsBenchQueueInit(&benchQueue);
+		tsBenchPipeInit(&benchPipe);
+
+		uint64_t start = tsBenchNow();
+		for (uint32_t i = 0; i < consumers; ++i)
+		{
+				pthread_create(&threads[i], NULL, benchConsumer, NULL);
+		}
+		for (uint32_t i = 0; i < producers; ++i)
+		{
+				pthread_create(&threads[consumers + i], NULL, benchProducer, (void *)(uintptr_t)i);
+		}
+		for (uint32_t i = 0; i < producers + consumers; ++i) pthread_join(threads[i], NULL);
+		uint64_t elapsed = tsBenchNow() - start;
+		free(threads);
+
+		*ok = benchSum == benchTotal * (benchTotal + 1) / 2;
+		return elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+		uint64_t elements = argc > 1 ? strtoull(argv[1], NULL, 10) : 4000000;
+		uint32_t maxProducers = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 4;
+		uint32_t maxConsumers = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 4;
+
+		int allOk = 1;
+		printf("%9s %9s %18s %18s %8s\n", "producers", "consumers", "locked pipe Mop/s",
+		    "mpmc queue Mop/s", "speedup");
+		for (uint32_t producers = 1; producers <= maxProducers; producers *= 2)
+		{
+				for (uint32_t consumers = 1; consumers <= maxConsumers; consumers *= 2)
+				{
+						int lockedOk, queueOk;
+						uint64_t lockedNs = benchRun(1, producers, consumers, elements, &lockedOk);
+						uint64_t queueNs = benchRun(0, producers, consumers, elements, &queueOk);
+						allOk &= lockedOk && queueOk;
+						printf("%9u %9u %18.2f %18.2f %7.2fx%s\n", producers, consumers,
+						    (double)elements * 1e3 / (double)lockedNs,
+						    (double)elements * 1e3 / (double)queueNs,
+						    (double)lockedNs / (double)queueNs,
+						    lockedOk && queueOk ? "" : "  WRONG SUM");
+				}
+		}
+		return allOk ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// {function, argument} pairs through "TStaggedpairpipe", taken with one 16-byte compare
+// exchange, against a pipe of the same pairs from "TS_PIPE_DEFINE", which claims a flag and
+// then copies the pair, like the pair pipe does where it has to fall back. First one thread
+// pushing to and stealing from pipes picked at random among many, then 1 writer against
+// "readers" thieves on a single pipe.
+//
+// Usage: pipe_bench_pair [max readers] [milliseconds per run] [max pipes]
+
+#include "./bench.h"
+#include "../pipe_tagged.h"
+
+enum
+{
+		BENCH_ROUNDS = 4000000
+};
+
+TS_PIPE_DEFINE(BenchPipeFlagged, benchPipeFlagged, TStaggedpair, TS_PIPE_SIZE_LOG2)
+TS_TAGGED_PAIR_PIPE_DEFINE(BenchPipeWide, benchPipeWide, TS_PIPE_SIZE_LOG2)
+
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+/// Stamp out the run functions "benchRandom##Layout" (see "TS_BENCH_RANDOM_PIPES_DEFINE")
+/// and "benchRun##Layout" for one kind of pipe.
+#define BENCH_PAIR_DEFINE(Layout) \
+		static inline int benchPush##Layout(BenchPipe##Layout *pipe, uint64_t value) \
+		{ \
+				TStaggedpair pair = {value, value}; \
+				return benchPipe##Layout##WriterTryWriteFront(pipe, &pair); \
+		} \
+		static inline int benchSteal##Layout(BenchPipe##Layout *pipe, uint64_t *value) \
+		{ \
+				TStaggedpair pair; \
+				if (!benchPipe##Layout##ReaderTryReadBack(pipe, &pair)) return 0; \
+				*value = pair.second; \
+				return 1; \
+		} \
+		TS_BENCH_RANDOM_PIPES_DEFINE(benchRandom##Layout, BenchPipe##Layout, \
+		    benchPipe##Layout##Init, benchPush##Layout, benchSteal##Layout) \
+		static BenchPipe##Layout benchPipeInstance##Layout; \
+		static void *benchWriter##Layout(void *arg) \
+		{ \
+				TStaggedpair pair = {0, 0}; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##WriterTryWriteFront(&benchPipeInstance##Layout, &pair)) \
+						{ \
+								++pair.second; \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				benchWritten = pair.second; \
+				return NULL; \
+		} \
+		static void *benchReader##Layout(void *arg) \
+		{ \
+				TStaggedpair value; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##ReaderTryReadBack(&benchPipeInstance##Layout, &value)) \
+						{ \
+								TS_BENCH_KEEP(value.second); \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				return NULL; \
+		} \
+		static double benchRun##Layout(uint32_t readers, uint32_t milliseconds) \
+		{ \
+				uint64_t elapsed; \
+				benchPipe##Layout##Init(&benchPipeInstance##Layout); \
+				elapsed = tsBenchRunThreads(benchWriter##Layout, benchReader##Layout, readers, \
+				    milliseconds, &benchStop); \
+				return (double)benchWritten * 1e9 / (double)elapsed; \
+		}
+
+BENCH_PAIR_DEFINE(Flagged)
+BENCH_PAIR_DEFINE(Wide)
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 4;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+		uint32_t maxPipes = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 4096;
+
+		if (!tsTaggedPairWideSupported())
+		{
+				printf("no 16-byte compare exchange here, both pipes run the flag protocol\n");
+		}
+		printf("bytes per pipe: %zu flagged, %zu pair\n\n", sizeof(BenchPipeFlagged),
+		    sizeof(BenchPipeWide));
+
+		printf("%6s %18s %18s %8s\n", "pipes", "flagged ns/round", "pair ns/round", "gain");
+		for (uint32_t pipes = 64; pipes <= maxPipes; pipes *= 2)
+		{
+				double flagged = benchRandomFlagged(pipes, BENCH_ROUNDS, NULL, NULL);
+				double wide = benchRandomWide(pipes, BENCH_ROUNDS, NULL, NULL);
+				printf("%6u %18.2f %18.2f %7.2fx\n", pipes, flagged, wide, flagged / wide);
+		}
+
+		printf("\n%8s %18s %18s %8s\n", "readers", "flagged Mitems/s", "pair Mitems/s", "gain");
+		for (uint32_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+				double flagged = benchRunFlagged(readers, milliseconds);
+				double wide = benchRunWide(readers, milliseconds);
+				printf("%8u %18.2f %18.2f %7.2fx\n", readers, flagged / 1e6, wide / 1e6,
+				    wide / flagged);
+		}
+		return 0;
+}
@@ -0,0 +1,130 @@
+// "tsSchedulerParallelFor" (lazy binary splitting) against static chunking, where the range
+// is cut into one equal chunk per worker up front, on all cores. In the uniform workload
+// every element costs the same, in the skewed one the last eighth costs 32 times as much.
+//
+// Usage: pipe_bench_parallel_for [elements]
+//
+// Built with "TS_PIPE_TRACE" as pipe_bench_trace, it also writes the last events of every
+// thread as a Chrome trace: pipe_bench_trace [elements] [trace file]
+
+#include "./bench.h"
+#include "../pipe_sched.h"
+
+struct BenchLoop
+{
+		uint64_t n;
+		int skewed;
+		uint64_t volatile checksum;
+};
+
+static inline uint64_t
+benchCost(const struct BenchLoop *loop, uint64_t i)
+{
+		return loop->skewed && i >= loop->n - loop->n / 8 ? 32 : 1;
+}
+
+static void
+benchBody(void *ctx, uint64_t begin, uint64_t end)
+{
+		struct BenchLoop *loop = (struct BenchLoop *)ctx;
+		uint64_t sum = 0;
+		for (uint64_t i = begin; i < end; ++i)
+		{
+				uint64_t x = i;
+				for (uint64_t k = benchCost(loop, i) * 16; k; --k)
+				{
+						x ^= x >> 33;
+						x *= 0xFF51AFD7ED558CCDull;
+				}
+				sum += x;
+		}
+		__atomic_fetch_add(&loop->checksum, sum, __ATOMIC_RELAXED);
+}
+
+struct BenchChunk
+{
+		struct BenchLoop *loop;
+		uint64_t begin;
+		uint64_t end;
+};
+
+static void
+benchChunk(void *arg)
+{
+		struct BenchChunk *chunk = (struct BenchChunk *)arg;
+		benchBody(chunk->loop, chunk->begin, chunk->end);
+}
+
+/// Run the loop once, return the elapsed milliseconds and store the checksum in "*sum".
+static double
+benchRun(TSscheduler *sched, uint64_t n, int skewed, int lazy, uint64_t *sum)
+{
+		struct BenchLoop loop = {n, skewed, 0};
+		uint64_t start = tsBenchNow();
+		if (lazy) { tsSchedulerParallelFor(sched, 0, n, benchBody, &loop); }
+		else
+		{
+				uint32_t chunks = sched->numWorkers;
+				struct BenchChunk *chunk = (struct BenchChunk *)malloc(chunks * sizeof(*chunk));
+				TScounter counter = {0};
+				for (uint32_t c = 0; c < chunks; ++c)
+				{
+						chunk[c].loop = &loop;
+						chunk[c].begin = n * c / chunks;
+						chunk[c].end = n * (c + 1) / chunks;
+						tsSchedulerSpawn(sched, benchChunk, &chunk[c], &counter);
+				}
+				tsSchedulerWait(sched, &counter);
+				free(chunk);
+		}
+		*sum = loop.checksum;
+		return (double)(tsBenchNow() - start) / 1e6;
+}
+
+int
+main(int argc, char **argv)
+{
+		static const char *const names[] = {"uniform", "skewed"};
+		uint64_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : (uint64_t)1 << 22;
+
+		TSscheduler sched;
+		if (!tsSchedulerInit(&sched, 0))
+		{
+				fprintf(stderr, "failed to start the scheduler\n");
+				return 1;
+		}
+
+		int ok = 1;
+		printf("%u workers, %llu elements\n", sched.numWorkers, (unsigned long long)n);
+		for (int skewed = 0; skewed < 2; ++skewed)
+		{
+				uint64_t staticSum, lazySum;
+				double staticMs = 1e300, lazyMs = 1e300;
+
+				// Best of a few runs, the first one also warms the workers up.
+				for (int run = 0; run < 5; ++run)
+				{
+						double ms = benchRun(&sched, n, skewed, 0, &staticSum);
+						if (ms < staticMs) staticMs = ms;
+						ms = benchRun(&sched, n, skewed, 1, &lazySum);
+						if (ms < lazyMs) lazyMs = ms;
+				}
+
+				ok &= staticSum == lazySum;
+				printf("%-8s static %9.2f ms, lazy splitting %9.2f ms (%.2fx)%s\n", names[skewed],
+				    staticMs, lazyMs, staticMs / lazyMs, staticSum == lazySum ? "" : "  WRONG SUM");
+		}
+
+		tsSchedulerDestroy(&sched);
+
+#ifdef TS_PIPE_TRACE
+		const char *path = argc > 2 ? argv[2] : "pipe_trace.json";
+		if (tsTraceWrite(path)) { printf("trace written to %s\n", path); }
+		else
+		{
+				fprintf(stderr, "failed to write %s\n", path);
+				ok = 0;
+		}
+#endif // TS_PIPE_TRACE
+		return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// Throughput and scaling of the default pipe layout: 1 writer against 0, 1, 2, 4... up to
+// "max readers" thieves, per payload size. The writer pushes and pops every 4th element
+// back from the front, as the owner of a work-stealing deque does, and pops instead of
+// pushing whenever the pipe is full. Results go to stdout as JSON so that runs of different
+// versions can be compared, a table for humans goes to stderr.
+//
+// "pipe_bench_stats" is the same built with "TS_PIPE_STATS", it adds the contention
+// counters of every run.
+//
+// Usage: pipe_bench [max readers] [milliseconds per run]
+
+#include <unistd.h>
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 10,
+		BENCH_MAX_READERS = 256
+};
+
+struct BenchCounter
+{
+		uint64_t count;
+} __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE)));
+
+static uint32_t volatile benchStop;
+static uint64_t benchPushes;
+static uint64_t benchPops;
+static struct BenchCounter benchSteals[BENCH_MAX_READERS];
+
+/// Stamp out a pipe of "bytes" sized payloads and the threads and run function
+/// "benchRun##bytes" driving it.
+#define BENCH_PIPE_DEFINE(bytes) \
+		typedef struct \
+		{ \
+				unsigned char bytes_[bytes]; \
+		} BenchPayload##bytes; \
+		TS_PIPE_DEFINE(BenchPipe##bytes, benchPipe##bytes, BenchPayload##bytes, \
+		    BENCH_PIPE_SIZE_LOG2) \
+		static BenchPipe##bytes benchPipeInstance##bytes; \
+		static void *benchWriter##bytes(void *arg) \
+		{ \
+				BenchPayload##bytes payload = {{0}}; \
+				uint64_t pushes = 0; \
+				uint64_t pops = 0; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##bytes##WriterTryWriteFront(&benchPipeInstance##bytes, &payload)) \
+						{ \
+								++payload.bytes_[0]; \
+								if (++pushes % 4) continue; \
+						} \
+						pops += \
+						    benchPipe##bytes##WriterTryReadFront(&benchPipeInstance##bytes, &payload); \
+				} \
+				benchPushes = pushes; \
+				benchPops = pops; \
+				return NULL; \
+		} \
+		static void *benchReader##bytes(void *arg) \
+		{ \
+				BenchPayload##bytes payload; \
+				uint64_t steals = 0; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##bytes##ReaderTryReadBack(&benchPipeInstance##bytes, &payload)) \
+						{ \
+								TS_BENCH_KEEP(payload.bytes_[0]); \
+								++steals; \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				benchSteals[(uintptr_t)arg].count = steals; \
+				return NULL; \
+		} \
+		static uint64_t benchRun##bytes(uint32_t readers, uint32_t milliseconds) \
+		{ \
+				benchPipe##bytes##Init(&benchPipeInstance##bytes); \
+				return tsBenchRunThreads(benchWriter##bytes, benchReader##bytes, readers, \
+				    milliseconds, &benchStop); \
+		}
+
+BENCH_PIPE_DEFINE(4)
+BENCH_PIPE_DEFINE(16)
+BENCH_PIPE_DEFINE(64)
+BENCH_PIPE_DEFINE(256)
+
+struct BenchCase
+{
+		uint32_t bytes;
+		uint64_t (*run)(uint32_t readers, uint32_t milliseconds);
+};
+
+static const struct BenchCase benchCases[] = {
+		{4, benchRun4}, {16, benchRun16}, {64, benchRun64}, {256, benchRun256}};
+
+#ifdef TS_PIPE_STATS
+/// Print the counts since "before" as a JSON member, the longest walk is that of all runs.
+static void
+benchPrintStats(const TSpipestats *before)
+{
+		TSpipestats after = tsPipeStatsCollect();
+		printf(", \"contention\": {\"reader_reads\": %llu, \"reader_empty\": %llu, "
+		    "\"reader_probes\": %llu, \"reader_cas_failures\": %llu, "
+		    "\"reader_restarts\": %llu, \"reader_longest_walk\": %llu, "
+		    "\"writer_pushes\": %llu, \"writer_full\": %llu, \"writer_pops\": %llu, "
+		    "\"writer_pop_empty\": %llu, \"writer_pop_cas_failures\": %llu, "
+		    "\"writer_pop_lost\": %llu}",
+		    (unsigned long long)(after.readerReads - before->readerReads),
+		    (unsigned long long)(after.readerEmpty - before->readerEmpty),
+		    (unsigned long long)(after.readerProbes - before->readerProbes),
+		    (unsigned long long)(after.readerCasFailures - before->readerCasFailures),
+		    (unsigned long long)(after.readerRestarts - before->readerRestarts),
+		    (unsigned long long)after.readerLongestWalk,
+		    (unsigned long long)(after.writerPushes - before->writerPushes),
+		    (unsigned long long)(after.writerFull - before->writerFull),
+		    (unsigned long long)(after.writerPops - before->writerPops),
+		    (unsigned long long)(after.writerPopEmpty - before->writerPopEmpty),
+		    (unsigned long long)(after.writerPopCasFailures - before->writerPopCasFailures),
+		    (unsigned long long)(after.writerPopLost - before->writerPopLost));
+}
+#endif // TS_PIPE_STATS
+
+int
+main(int argc, char **argv)
+{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 0;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+
+		// One reader per core left next to the writer, but at least one.
+		if (maxReaders == 0) maxReaders = cores > 2 ? (uint32_t)cores - 1 : 1;
+		if (maxReaders > BENCH_MAX_READERS) maxReaders = BENCH_MAX_READERS;
+
+		printf("{\n  \"benchmark\": \"pipe_bench\",\n");
+		printf("  \"compiler\": \"%s\",\n", __VERSION__);
+		printf("  \"cores\": %ld,\n", cores);
+		printf("  \"pipe_size\": %u,\n", 1u << BENCH_PIPE_SIZE_LOG2);
+		printf("  \"cache_line_size\": %u,\n", TS_PIPE_CACHE_LINE_SIZE);
+#ifdef TS_PIPE_ISOLATE_INDICES
+		printf("  \"isolate_indices\": true,\n");
+#else
+		printf("  \"isolate_indices\": false,\n");
+#endif // TS_PIPE_ISOLATE_INDICES
+#ifdef TS_PIPE_INTERLEAVED_SLOTS
+		printf("  \"interleaved_slots\": true,\n");
+#else
+		printf("  \"interleaved_slots\": false,\n");
+#endif // TS_PIPE_INTERLEAVED_SLOTS
+		printf("  \"milliseconds\": %u,\n  \"results\": [", milliseconds);
+
+		fprintf(stderr, "%8s %8s %14s %14s %14s %14s\n", "bytes", "readers", "push (M/s)",
+		    "pop (M/s)", "steal (M/s)", "total (M/s)");
+		int first = 1;
+		for (size_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); ++i)
+		{
+				for (uint32_t readers = 0; readers <= maxReaders; readers = readers ? readers * 2 : 1)
+				{
+						// Keep the last step at "maxReaders" even when it is not a power of two.
+						if (readers > maxReaders / 2 && readers < maxReaders) readers = maxReaders;
+
+#ifdef TS_PIPE_STATS
+						TSpipestats before = tsPipeStatsCollect();
+#endif // TS_PIPE_STATS
+						uint64_t elapsed = benchCases[i].run(readers, milliseconds);
+						uint64_t steals = 0;
+						for (uint32_t r = 0; r < readers; ++r) steals += benchSteals[r].count;
+
+						double seconds = (double)elapsed / 1e9;
+						double push = (double)benchPushes / seconds;
+						double pop = (double)benchPops / seconds;
+						double steal = (double)steals / seconds;
+						printf("%s\n    {\"payload_bytes\": %u, \"readers\": %u, "
+						    "\"push_ops_per_s\": %.0f, "
+						    "\"pop_ops_per_s\": %.0f, \"steal_ops_per_s\": %.0f, "
+						    "\"total_ops_per_s\": %.0f",
+						    first ? "" : ",", benchCases[i].bytes, readers, push, pop, steal,
+						    push + pop + steal);
+#ifdef TS_PIPE_STATS
+						benchPrintStats(&before);
+#endif // TS_PIPE_STATS
+						printf("}");
+						fprintf(stderr, "%8u %8u %14.2f %14.2f %14.2f %14.2f\n", benchCases[i].bytes,
+						    readers, push / 1e6, pop / 1e6, steal / 1e6, (push + pop + steal) / 1e6);
+						first = 0;
+				}
+		}
+		printf("\n  ]\n}\n");
+		return 0;
+}
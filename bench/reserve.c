@@ -0,0 +1,96 @@
+// Writing 128 byte records: "WriterTryWriteFront", which copies a record built on the stack
+// into the pipe, against "WriterReserveFront" and "WriterCommitFront", which build it right
+// in its slot. One thread fills half the pipe and then drains it, only the filling is timed.
+// The draining keeps the records from being optimized away.
+//
+// Usage: pipe_bench_reserve [rounds]
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 10,
+		BENCH_BURST = 1 << (BENCH_PIPE_SIZE_LOG2 - 1)
+};
+
+struct BenchRecord
+{
+		uint64_t sequence;
+		uint64_t fields[15];
+};
+
+typedef struct BenchRecord BenchRecord;
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, BenchRecord, BENCH_PIPE_SIZE_LOG2)
+
+static TSbenchpipe benchPipe;
+
+/// Out of line, like the parser or the decoder that fills records in real code.
+static void __attribute__((noinline))
+benchFill(BenchRecord *record, uint64_t sequence)
+{
+		record->sequence = sequence;
+		for (uint32_t i = 0; i < 15; ++i) record->fields[i] = sequence * (i + 1);
+}
+
+/// Nanoseconds per record written, store the checksum of what was read in "*sum".
+static double
+benchRun(int inPlace, uint64_t rounds, uint64_t *sum)
+{
+		BenchRecord out[64];
+		uint64_t sequence = 0;
+		uint64_t elapsed = 0;
+		*sum = 0;
+		tsBenchPipeInit(&benchPipe);
+
+		for (uint64_t round = 0; round < rounds; ++round)
+		{
+				uint64_t start = tsBenchNow();
+				for (uint32_t i = 0; i < BENCH_BURST; ++i, ++sequence)
+				{
+						if (inPlace)
+						{
+								BenchRecord *record = tsBenchPipeWriterReserveFront(&benchPipe);
+								benchFill(record, sequence);
+								tsBenchPipeWriterCommitFront(&benchPipe);
+						}
+						else
+						{
+								BenchRecord record;
+								benchFill(&record, sequence);
+								tsBenchPipeWriterTryWriteFront(&benchPipe, &record);
+						}
+				}
+				elapsed += tsBenchNow() - start;
+
+				uint32_t read;
+				while ((read = tsBenchPipeReaderTryReadBackHalf(&benchPipe, out, 64)))
+				{
+						for (uint32_t i = 0; i < read; ++i) *sum += out[i].sequence + out[i].fields[14];
+				}
+		}
+		return (double)elapsed / ((double)rounds * BENCH_BURST);
+}
+
+int
+main(int argc, char **argv)
+{
+		uint64_t rounds = argc > 1 ? strtoull(argv[1], NULL, 10) : 20000;
+		uint64_t copySum, inPlaceSum;
+		double copyNs = 1e300, inPlaceNs = 1e300;
+
+		// Best of a few runs, the first one also warms the caches up.
+		for (int run = 0; run < 5; ++run)
+		{
+				double ns = benchRun(0, rounds, &copySum);
+				if (ns < copyNs) copyNs = ns;
+				ns = benchRun(1, rounds, &inPlaceSum);
+				if (ns < inPlaceNs) inPlaceNs = ns;
+		}
+
+		printf("%zu byte records: copy %7.2f ns, reserve/commit %7.2f ns (%.2fx)%s\n",
+		    sizeof(BenchRecord), copyNs, inPlaceNs, copyNs / inPlaceNs,
+		    copySum == inPlaceSum ? "" : "  WRONG SUM");
+		return copySum == inPlaceSum ? 0 : 1;
+}
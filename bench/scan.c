@@ -0,0 +1,101 @@
+// Readers walking past claimed flags on a "TSpipe", built once walking the flags one by one
+// and once with "TS_PIPE_SIMD_SCAN", and driven by "scan_main.c": a single reader walking
+// past a given number of claimed flags, then one writer against "readers" thieves. Both
+// count with "TS_PIPE_STATS", so the compare exchanges readers lose can be told apart.
+
+#include "./bench.h"
+#include "../pipe.h"
+
+#ifdef TS_PIPE_SIMD_SCAN
+#		define BENCH_SCAN_WALK benchScanWalkSimd
+#		define BENCH_SCAN_RUN  benchScanSimd
+#else
+#		define BENCH_SCAN_WALK benchScanWalkScalar
+#		define BENCH_SCAN_RUN  benchScanScalar
+#endif
+
+static TSpipe benchPipe;
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+static void *
+benchWriter(void *arg)
+{
+		TSpipedata values[16] = {0};
+		uint64_t written = 0;
+		(void)arg;
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				// Bursts, so that thieves find deep pipes to walk.
+				uint32_t n = tsPipeWriterTryWriteFrontN(&benchPipe, values, 16);
+				if (n) written += n;
+				else tsBenchPause();
+		}
+		benchWritten = written;
+		return NULL;
+}
+
+static void *
+benchReader(void *arg)
+{
+		TSpipedata value;
+		(void)arg;
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				if (tsPipeReaderTryReadBack(&benchPipe, &value)) { TS_BENCH_KEEP(value); }
+				else { tsBenchPause(); }
+		}
+		return NULL;
+}
+
+/// Nanoseconds per claim of a reader that finds the first "claimed" flags taken by readers
+/// that have not counted them in "readCount" yet, as happens with many readers at once.
+/// The flags are reset before every claim, which is timed along with it.
+double
+BENCH_SCAN_WALK(uint32_t claimed)
+{
+		enum
+		{
+				BENCH_CLAIMS = 1000000
+		};
+		TSpipeview view = tsPipeView(&benchPipe);
+		uint32_t slot = 0;
+		uint64_t slots = 0;
+		tsPipeInit(&benchPipe);
+		for (uint32_t i = 0; i <= claimed; ++i) tsPipeWriterTryWriteFront(&benchPipe, &i);
+
+		uint64_t start = tsBenchNow();
+		for (uint32_t n = 0; n < BENCH_CLAIMS; ++n)
+		{
+				for (uint32_t i = 0; i < claimed; ++i)
+				{
+						tsPipeFlagStore(tsPipeViewFlag(view, i), TS_PIPE_INVALID, TS_RELAXED);
+				}
+				tsPipeFlagStore(tsPipeViewFlag(view, claimed), TS_PIPE_READABLE, TS_RELAXED);
+				tsAtomicStore_u32(view.readCount, 0, TS_RELAXED);
+				tsPipeViewReaderClaimBack(view, &slot);
+				slots += slot;
+		}
+		uint64_t elapsed = tsBenchNow() - start;
+
+		// Every claim must have found the element right past the claimed ones.
+		if (slots != (uint64_t)claimed * BENCH_CLAIMS) return -1.0;
+		return (double)elapsed / BENCH_CLAIMS;
+}
+
+/// Run for "milliseconds" and return the elements passed through the pipe per second,
+/// store the compare exchanges readers lost per element read in "*casFailures".
+double
+BENCH_SCAN_RUN(uint32_t readers, uint32_t milliseconds, double *casFailures)
+{
+		TSpipestats before = tsPipeStatsCollect();
+		tsPipeInit(&benchPipe);
+		uint64_t elapsed =
+		    tsBenchRunThreads(benchWriter, benchReader, readers, milliseconds, &benchStop);
+		TSpipestats after = tsPipeStatsCollect();
+
+		uint64_t reads = after.readerReads - before.readerReads;
+		*casFailures =
+		    reads ? (double)(after.readerCasFailures - before.readerCasFailures) / reads : 0;
+		return (double)benchWritten * 1e9 / (double)elapsed;
+}
@@ -0,0 +1,40 @@
+// Readers walking past claimed flags one by one against scanning them a vector at a time
+// ("TS_PIPE_SIMD_SCAN"). First the cost of a claim walking past 0 to 64 claimed flags, which
+// is what readers pay when many of them steal at once; then the throughput of 1 writer and
+// 1 to "max readers" thieves, and the compare exchanges readers lose per element read.
+//
+// Usage: pipe_bench_scan [max readers] [milliseconds per run]
+
+#include "./bench.h"
+
+double benchScanWalkScalar(uint32_t claimed);
+double benchScanWalkSimd(uint32_t claimed);
+double benchScanScalar(uint32_t readers, uint32_t milliseconds, double *casFailures);
+double benchScanSimd(uint32_t readers, uint32_t milliseconds, double *casFailures);
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 32;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+
+		printf("%8s %18s %18s %8s\n", "claimed", "scalar (ns/claim)", "simd (ns/claim)", "gain");
+		for (uint32_t claimed = 0; claimed <= 64; claimed = claimed ? claimed * 2 : 1)
+		{
+				double scalar = benchScanWalkScalar(claimed);
+				double simd = benchScanWalkSimd(claimed);
+				printf("%8u %18.2f %18.2f %7.2fx\n", claimed, scalar, simd, scalar / simd);
+		}
+
+		printf("\n%8s %18s %18s %8s %18s %18s\n", "readers", "scalar (Mitems/s)",
+		    "simd (Mitems/s)", "gain", "scalar lost/read", "simd lost/read");
+		for (uint32_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+				double scalarLost, simdLost;
+				double scalar = benchScanScalar(readers, milliseconds, &scalarLost);
+				double simd = benchScanSimd(readers, milliseconds, &simdLost);
+				printf("%8u %18.2f %18.2f %7.2fx %18.3f %18.3f\n", readers, scalar / 1e6, simd / 1e6,
+				    simd / scalar, scalarLost, simdLost);
+		}
+		return 0;
+}
@@ -0,0 +1,124 @@
+// Exercise "TSscheduler" on 1, 2, 4... up to all cores: a recursive Fibonacci spawning a
+// task per call, then a flood of tasks submitted from outside the pool. Every result is
+// checked, the exit status is 1 if any is wrong.
+//
+// Usage: pipe_bench_sched [fibonacci n] [external tasks]
+
+#include "./bench.h"
+#include "../pipe_sched.h"
+
+struct BenchFib
+{
+		TSscheduler *sched;
+		uint32_t n;
+		uint64_t result;
+};
+
+static void
+benchFib(void *arg)
+{
+		struct BenchFib *fib = (struct BenchFib *)arg;
+		if (fib->n < 2)
+		{
+				fib->result = fib->n;
+				return;
+		}
+
+		// Below this the tasks would be too small to be worth spawning.
+		if (fib->n < 12)
+		{
+				struct BenchFib a = {fib->sched, fib->n - 1, 0};
+				struct BenchFib b = {fib->sched, fib->n - 2, 0};
+				benchFib(&a);
+				benchFib(&b);
+				fib->result = a.result + b.result;
+				return;
+		}
+
+		TScounter counter = {0};
+		struct BenchFib a = {fib->sched, fib->n - 1, 0};
+		struct BenchFib b = {fib->sched, fib->n - 2, 0};
+		tsSchedulerSpawn(fib->sched, benchFib, &a, &counter);
+		tsSchedulerSpawn(fib->sched, benchFib, &b, &counter);
+		tsSchedulerWait(fib->sched, &counter);
+		fib->result = a.result + b.result;
+}
+
+static uint64_t
+benchFibExpected(uint32_t n)
+{
+		uint64_t a = 0, b = 1;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+				uint64_t c = a + b;
+				a = b;
+				b = c;
+		}
+		return a;
+}
+
+static uint64_t volatile benchSum;
+
+static void
+benchAdd(void *arg)
+{
+		__atomic_fetch_add(&benchSum, (uint64_t)(uintptr_t)arg, __ATOMIC_RELAXED);
+}
+
+/// Run both workloads on "workers" threads, return 0 if a result was wrong.
+static int
+benchRun(uint32_t workers, uint32_t n, uint32_t tasks)
+{
+		TSscheduler sched;
+		if (!tsSchedulerInit(&sched, workers))
+		{
+				fprintf(stderr, "failed to start %u workers\n", workers);
+				return 0;
+		}
+
+		// The root task is spawned from outside the pool like any other submission.
+		TScounter counter = {0};
+		struct BenchFib fib = {&sched, n, 0};
+		uint64_t start = tsBenchNow();
+		tsSchedulerSpawn(&sched, benchFib, &fib, &counter);
+		tsSchedulerWait(&sched, &counter);
+		double fibMs = (double)(tsBenchNow() - start) / 1e6;
+
+		benchSum = 0;
+		start = tsBenchNow();
+		for (uint32_t i = 1; i <= tasks; ++i)
+		{
+				tsSchedulerSpawn(&sched, benchAdd, (void *)(uintptr_t)i, &counter);
+		}
+		tsSchedulerWait(&sched, &counter);
+		double externalMs = (double)(tsBenchNow() - start) / 1e6;
+
+		// Left over tasks must still run on shutdown.
+		for (uint32_t i = 1; i <= tasks; ++i)
+		{
+				tsSchedulerSpawn(&sched, benchAdd, (void *)(uintptr_t)i, NULL);
+		}
+		tsSchedulerDestroy(&sched);
+
+		uint64_t expectedSum = (uint64_t)tasks * (tasks + 1) / 2;
+		int ok = fib.result == benchFibExpected(n) && benchSum == 2 * expectedSum;
+		printf("%3u workers: fib(%u) %9.2f ms, %u external tasks %9.2f ms%s\n", workers, n,
+		    fibMs, tasks, externalMs, ok ? "" : "  WRONG RESULT");
+		return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+		uint32_t n = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 32;
+		uint32_t tasks = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 1000000;
+		uint32_t cores = tsSchedNumCores();
+
+		int ok = 1;
+		for (uint32_t workers = 1; workers < cores; workers *= 2)
+		{
+				ok &= benchRun(workers, n, tasks);
+		}
+		ok &= benchRun(cores, n, tasks);
+		return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// "TSseqpipe" against "TSpipe": one thread pushing and stealing, or pushing and popping,
+// in turns on a half full pipe; then 1 writer against "readers" thieves, where the
+// sequence-numbered pipe's readers go straight for the next element instead of probing
+// flags. Both pipes hold as many elements of "TSpipedata".
+//
+// Usage: pipe_bench_seq [max readers] [milliseconds per run]
+
+#include "./bench.h"
+#include "../pipe_seq.h"
+
+enum
+{
+		BENCH_ROUNDS = 10000000
+};
+
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+/// Stamp out the run functions "bench*##Kind" for pipes of "Type" and functions "prefix##*".
+#define BENCH_SEQ_DEFINE(Kind, Type, prefix) \
+		static Type benchPipe##Kind; \
+		/* Nanoseconds per push followed by a steal, or a pop if "pop". */ \
+		static double benchTurns##Kind(int pop) \
+		{ \
+				TSpipedata value = 0; \
+				uint64_t sum = 0; \
+				uint64_t start; \
+				prefix##Init(&benchPipe##Kind); \
+				for (uint32_t i = 0; i < TS_PIPE_SIZE / 2; ++i) \
+				{ \
+						prefix##WriterTryWriteFront(&benchPipe##Kind, &value); \
+				} \
+				start = tsBenchNow(); \
+				for (uint32_t n = 0; n < BENCH_ROUNDS; ++n) \
+				{ \
+						value = (TSpipedata)n; \
+						prefix##WriterTryWriteFront(&benchPipe##Kind, &value); \
+						if (pop) prefix##WriterTryReadFront(&benchPipe##Kind, &value); \
+						else prefix##ReaderTryReadBack(&benchPipe##Kind, &value); \
+						sum += value; \
+				} \
+				start = tsBenchNow() - start; \
+				TS_BENCH_KEEP(sum); \
+				return (double)start / BENCH_ROUNDS; \
+		} \
+		static void *benchWriter##Kind(void *arg) \
+		{ \
+				TSpipedata value = 0; \
+				uint64_t written = 0; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (prefix##WriterTryWriteFront(&benchPipe##Kind, &value)) ++written; \
+						else tsBenchPause(); \
+				} \
+				benchWritten = written; \
+				return NULL; \
+		} \
+		static void *benchReader##Kind(void *arg) \
+		{ \
+				TSpipedata value; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (prefix##ReaderTryReadBack(&benchPipe##Kind, &value)) TS_BENCH_KEEP(value); \
+						else tsBenchPause(); \
+				} \
+				return NULL; \
+		} \
+		static double benchRun##Kind(uint32_t readers, uint32_t milliseconds) \
+		{ \
+				uint64_t elapsed; \
+				prefix##Init(&benchPipe##Kind); \
+				elapsed = tsBenchRunThreads(benchWriter##Kind, benchReader##Kind, readers, \
+				    milliseconds, &benchStop); \
+				return (double)benchWritten * 1e9 / (double)elapsed; \
+		}
+
+BENCH_SEQ_DEFINE(Pipe, TSpipe, tsPipe)
+BENCH_SEQ_DEFINE(SeqPipe, TSseqpipe, tsSeqPipe)
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 8;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+
+		printf("%12s %14s %14s %8s\n", "one thread", "pipe ns/round", "seq ns/round", "gain");
+		for (int pop = 0; pop <= 1; ++pop)
+		{
+				double pipe = benchTurnsPipe(pop);
+				double seq = benchTurnsSeqPipe(pop);
+				printf("%12s %14.2f %14.2f %7.2fx\n", pop ? "push, pop" : "push, steal", pipe, seq,
+				    pipe / seq);
+		}
+
+		printf("\n%8s %18s %18s %8s\n", "readers", "pipe Mitems/s", "seq Mitems/s", "gain");
+		for (uint32_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+				double pipe = benchRunPipe(readers, milliseconds);
+				double seq = benchRunSeqPipe(readers, milliseconds);
+				printf("%8u %18.2f %18.2f %7.2fx\n", readers, pipe / 1e6, seq / 1e6, seq / pipe);
+		}
+		return 0;
+}
@@ -0,0 +1,125 @@
+// Separate "buffer" and "flags" arrays ("TS_PIPE_DEFINE") against interleaved slots
+// ("TS_PIPE_DEFINE_INTERLEAVED") and slots padded to a cache line
+// ("TS_PIPE_DEFINE_INTERLEAVED_PADDED"), with 1 writer and "readers" thieves, per payload
+// size.
+//
+// Usage: pipe_bench_slots [readers] [milliseconds per run]
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 10
+};
+
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+/// Stamp out a pipe of "bytes" sized payloads with layout "define" and the threads and run
+/// function "benchRun##Layout##bytes" driving it.
+#define BENCH_SLOTS_DEFINE(Layout, define, bytes) \
+		define(BenchPipe##Layout##bytes, benchPipe##Layout##bytes, BenchPayload##bytes, \
+		    BENCH_PIPE_SIZE_LOG2) \
+		static BenchPipe##Layout##bytes benchPipeInstance##Layout##bytes; \
+		static void *benchWriter##Layout##bytes(void *arg) \
+		{ \
+				BenchPayload##bytes payload = {{0}}; \
+				uint64_t written = 0; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##bytes##WriterTryWriteFront( \
+								    &benchPipeInstance##Layout##bytes, &payload)) \
+						{ \
+								++payload.bytes_[0]; \
+								++written; \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				benchWritten = written; \
+				return NULL; \
+		} \
+		static void *benchReader##Layout##bytes(void *arg) \
+		{ \
+				BenchPayload##bytes payload; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##bytes##ReaderTryReadBack( \
+								    &benchPipeInstance##Layout##bytes, &payload)) \
+						{ \
+								TS_BENCH_KEEP(payload.bytes_[0]); \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				return NULL; \
+		} \
+		static double benchRun##Layout##bytes(uint32_t readers, uint32_t milliseconds) \
+		{ \
+				uint64_t elapsed; \
+				benchPipe##Layout##bytes##Init(&benchPipeInstance##Layout##bytes); \
+				elapsed = tsBenchRunThreads(benchWriter##Layout##bytes, benchReader##Layout##bytes, \
+				    readers, milliseconds, &benchStop); \
+				return (double)benchWritten * 1e9 / (double)elapsed; \
+		}
+
+#define BENCH_SLOTS_DEFINE_SIZE(bytes) \
+		typedef struct \
+		{ \
+				unsigned char bytes_[bytes]; \
+		} BenchPayload##bytes; \
+		BENCH_SLOTS_DEFINE(Separate, TS_PIPE_DEFINE, bytes) \
+		BENCH_SLOTS_DEFINE(Interleaved, TS_PIPE_DEFINE_INTERLEAVED, bytes) \
+		BENCH_SLOTS_DEFINE(Padded, TS_PIPE_DEFINE_INTERLEAVED_PADDED, bytes)
+
+BENCH_SLOTS_DEFINE_SIZE(4)
+BENCH_SLOTS_DEFINE_SIZE(8)
+BENCH_SLOTS_DEFINE_SIZE(16)
+BENCH_SLOTS_DEFINE_SIZE(32)
+BENCH_SLOTS_DEFINE_SIZE(64)
+BENCH_SLOTS_DEFINE_SIZE(128)
+BENCH_SLOTS_DEFINE_SIZE(256)
+
+struct BenchSlotsCase
+{
+		uint32_t bytes;
+		double (*run[3])(uint32_t readers, uint32_t milliseconds);
+};
+
+#define BENCH_SLOTS_CASE(bytes) \
+		{ \
+				bytes, { benchRunSeparate##bytes, benchRunInterleaved##bytes, benchRunPadded##bytes } \
+		}
+
+static const struct BenchSlotsCase benchCases[] = {BENCH_SLOTS_CASE(4),
+    BENCH_SLOTS_CASE(8),
+    BENCH_SLOTS_CASE(16),
+    BENCH_SLOTS_CASE(32),
+    BENCH_SLOTS_CASE(64),
+    BENCH_SLOTS_CASE(128),
+    BENCH_SLOTS_CASE(256)};
+
+int
+main(int argc, char **argv)
+{
+		static const char *const layouts[3] = {"separate", "interleaved", "padded"};
+		uint32_t readers = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 3;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+
+		printf("1 writer, %u readers, Mitems/s\n", readers);
+		printf("%8s %12s %12s %12s %12s\n", "bytes", layouts[0], layouts[1], layouts[2], "winner");
+		for (size_t i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); ++i)
+		{
+				double result[3];
+				int best = 0;
+				for (int layout = 0; layout < 3; ++layout)
+				{
+						result[layout] = benchCases[i].run[layout](readers, milliseconds);
+						if (result[layout] > result[best]) best = layout;
+				}
+				printf("%8u %12.2f %12.2f %12.2f %12s\n", benchCases[i].bytes, result[0] / 1e6,
+				    result[1] / 1e6, result[2] / 1e6, layouts[best]);
+		}
+		return 0;
+}
@@ -0,0 +1,144 @@
+// One writer, one reader: "TSspscpipe" against the default pipe, whose reader pays for a
+// compare exchange and a fetch-add per element to be safe against other readers there are
+// none of. First the cost of a write and a read by a single thread, then the throughput of
+// a writer and a reader thread. The reader checks that elements arrive in order, the exit
+// status is 1 if any does not.
+//
+// Usage: pipe_bench_spsc [milliseconds]
+
+#include <sched.h>
+
+#include "./bench.h"
+#include "../pipe_spsc.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 10
+};
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, uint64_t, BENCH_PIPE_SIZE_LOG2)
+TS_SPSC_PIPE_DEFINE(TSbenchspscpipe, tsBenchSpscPipe, uint64_t, BENCH_PIPE_SIZE_LOG2)
+
+static TSbenchpipe benchPipe;
+static TSbenchspscpipe benchSpscPipe;
+static int benchSpsc;
+static uint32_t volatile benchStop;
+static uint64_t benchRead;
+static int benchInOrder;
+
+/// Wait for the other side, giving the core away now and then in case it needs it.
+static inline void
+benchBackoff(uint32_t *failures)
+{
+		if (++*failures & 63) tsBenchPause();
+		else sched_yield();
+}
+
+static void *
+benchWriter(void *arg)
+{
+		uint64_t value = 1;
+		uint32_t failures = 0;
+		(void)arg;
+
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				int written = benchSpsc ? tsBenchSpscPipeWriterTryWriteFront(&benchSpscPipe, &value) :
+														    tsBenchPipeWriterTryWriteFront(&benchPipe, &value);
+				if (written) ++value;
+				else benchBackoff(&failures);
+		}
+		return NULL;
+}
+
+static void *
+benchReader(void *arg)
+{
+		uint64_t expected = 1;
+		int inOrder = 1;
+		uint32_t failures = 0;
+		(void)arg;
+
+		while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED))
+		{
+				uint64_t value;
+				int read = benchSpsc ? tsBenchSpscPipeReaderTryReadBack(&benchSpscPipe, &value) :
+												    tsBenchPipeReaderTryReadBack(&benchPipe, &value);
+				if (read)
+				{
+						inOrder &= value == expected;
+						++expected;
+				}
+				else { benchBackoff(&failures); }
+		}
+		benchRead = expected - 1;
+		benchInOrder = inOrder;
+		return NULL;
+}
+
+/// Nanoseconds per element for one thread filling half the pipe and draining it again.
+static double
+benchAlone(int spsc)
+{
+		enum
+		{
+				BENCH_ROUNDS = 20000,
+				BENCH_BURST = 1 << (BENCH_PIPE_SIZE_LOG2 - 1)
+		};
+		uint64_t sum = 0;
+		tsBenchPipeInit(&benchPipe);
+		tsBenchSpscPipeInit(&benchSpscPipe);
+
+		uint64_t start = tsBenchNow();
+		for (uint64_t round = 0; round < BENCH_ROUNDS; ++round)
+		{
+				for (uint64_t i = 0; i < BENCH_BURST; ++i)
+				{
+						if (spsc) tsBenchSpscPipeWriterTryWriteFront(&benchSpscPipe, &i);
+						else tsBenchPipeWriterTryWriteFront(&benchPipe, &i);
+				}
+				for (uint64_t i = 0; i < BENCH_BURST; ++i)
+				{
+						uint64_t value;
+						int read;
+						if (spsc) read = tsBenchSpscPipeReaderTryReadBack(&benchSpscPipe, &value);
+						else read = tsBenchPipeReaderTryReadBack(&benchPipe, &value);
+						if (read) sum += value;
+				}
+		}
+		uint64_t elapsed = tsBenchNow() - start;
+		TS_BENCH_KEEP(sum);
+		return (double)elapsed / ((double)BENCH_ROUNDS * BENCH_BURST);
+}
+
+/// Run the link for "milliseconds", return the elements read per microsecond.
+static double
+benchRun(int spsc, uint32_t milliseconds)
+{
+		benchSpsc = spsc;
+		tsBenchPipeInit(&benchPipe);
+		tsBenchSpscPipeInit(&benchSpscPipe);
+		uint64_t elapsed =
+		    tsBenchRunThreads(benchWriter, benchReader, 1, milliseconds, &benchStop);
+		return (double)benchRead * 1e3 / (double)elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+		uint32_t milliseconds = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000;
+
+		double pipeNs = benchAlone(0);
+		double spscNs = benchAlone(1);
+		printf("one thread:  pipe %9.2f ns, single-reader pipe %9.2f ns (%.2fx)\n", pipeNs,
+		    spscNs, pipeNs / spscNs);
+
+		double pipeMops = benchRun(0, milliseconds);
+		int ok = benchInOrder;
+		double spscMops = benchRun(1, milliseconds);
+		ok &= benchInOrder;
+
+		printf("two threads: pipe %9.2f Mop/s, single-reader pipe %9.2f Mop/s (%.2fx)%s\n",
+		    pipeMops, spscMops, spscMops / pipeMops, ok ? "" : "  OUT OF ORDER");
+		return ok ? 0 : 1;
+}
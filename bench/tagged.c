@@ -0,0 +1,126 @@
+// Task handles through "TStaggedpipe", whose slots carry their own state, against pipes of
+// "uint64_t" keeping a flag apart ("TS_PIPE_DEFINE") or next to it
+// ("TS_PIPE_DEFINE_INTERLEAVED"). First one thread pushing to and stealing from pipes
+// picked at random among many, where the lines a steal touches count; then 1 writer against
+// "readers" thieves on a single pipe.
+//
+// Usage: pipe_bench_tagged [max readers] [milliseconds per run] [max pipes]
+
+#include "./bench.h"
+#include "../pipe_tagged.h"
+
+enum
+{
+		BENCH_ROUNDS = 4000000
+};
+
+TS_PIPE_DEFINE(BenchPipeSeparate, benchPipeSeparate, uint64_t, TS_PIPE_SIZE_LOG2)
+TS_PIPE_DEFINE_INTERLEAVED(BenchPipeInterleaved, benchPipeInterleaved, uint64_t,
+    TS_PIPE_SIZE_LOG2)
+TS_TAGGED_PIPE_DEFINE(BenchPipeTagged, benchPipeTaggedRaw_, TS_PIPE_SIZE_LOG2)
+
+// Same signatures as the other two.
+static inline int
+benchPipeTaggedWriterTryWriteFront(BenchPipeTagged *pipe, const uint64_t *in)
+{
+		return benchPipeTaggedRaw_WriterTryWriteFront(pipe, *in);
+}
+
+static inline int
+benchPipeTaggedReaderTryReadBack(BenchPipeTagged *pipe, uint64_t *out)
+{
+		return benchPipeTaggedRaw_ReaderTryReadBack(pipe, out);
+}
+
+static inline void
+benchPipeTaggedInit(BenchPipeTagged *pipe)
+{
+		benchPipeTaggedRaw_Init(pipe);
+}
+
+static uint32_t volatile benchStop;
+static uint64_t benchWritten;
+
+/// Stamp out the run functions "benchRandom##Layout" (see "TS_BENCH_RANDOM_PIPES_DEFINE")
+/// and "benchRun##Layout" for one kind of pipe.
+#define BENCH_TAGGED_DEFINE(Layout) \
+		static inline int benchPush##Layout(BenchPipe##Layout *pipe, uint64_t value) \
+		{ \
+				return benchPipe##Layout##WriterTryWriteFront(pipe, &value); \
+		} \
+		TS_BENCH_RANDOM_PIPES_DEFINE(benchRandom##Layout, BenchPipe##Layout, \
+		    benchPipe##Layout##Init, benchPush##Layout, benchPipe##Layout##ReaderTryReadBack) \
+		static BenchPipe##Layout benchPipeInstance##Layout; \
+		static void *benchWriter##Layout(void *arg) \
+		{ \
+				uint64_t written = 0; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##WriterTryWriteFront( \
+								    &benchPipeInstance##Layout, &written)) \
+						{ \
+								++written; \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				benchWritten = written; \
+				return NULL; \
+		} \
+		static void *benchReader##Layout(void *arg) \
+		{ \
+				uint64_t value; \
+				(void)arg; \
+				while (!tsAtomicLoad_u32(&benchStop, TS_RELAXED)) \
+				{ \
+						if (benchPipe##Layout##ReaderTryReadBack(&benchPipeInstance##Layout, &value)) \
+						{ \
+								TS_BENCH_KEEP(value); \
+						} \
+						else { tsBenchPause(); } \
+				} \
+				return NULL; \
+		} \
+		static double benchRun##Layout(uint32_t readers, uint32_t milliseconds) \
+		{ \
+				uint64_t elapsed; \
+				benchPipe##Layout##Init(&benchPipeInstance##Layout); \
+				elapsed = tsBenchRunThreads(benchWriter##Layout, benchReader##Layout, readers, \
+				    milliseconds, &benchStop); \
+				return (double)benchWritten * 1e9 / (double)elapsed; \
+		}
+
+BENCH_TAGGED_DEFINE(Separate)
+BENCH_TAGGED_DEFINE(Interleaved)
+BENCH_TAGGED_DEFINE(Tagged)
+
+int
+main(int argc, char **argv)
+{
+		uint32_t maxReaders = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 4;
+		uint32_t milliseconds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 200;
+		uint32_t maxPipes = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 4096;
+
+		printf("bytes per pipe: %zu separate, %zu interleaved, %zu tagged\n\n",
+		    sizeof(BenchPipeSeparate), sizeof(BenchPipeInterleaved), sizeof(BenchPipeTagged));
+
+		printf("%6s %18s %18s %18s\n", "pipes", "separate ns/round", "interleaved", "tagged");
+		for (uint32_t pipes = 64; pipes <= maxPipes; pipes *= 2)
+		{
+				printf("%6u %18.2f %18.2f %18.2f\n", pipes,
+				    benchRandomSeparate(pipes, BENCH_ROUNDS, NULL, NULL),
+				    benchRandomInterleaved(pipes, BENCH_ROUNDS, NULL, NULL),
+				    benchRandomTagged(pipes, BENCH_ROUNDS, NULL, NULL));
+		}
+
+		printf("\n%8s %18s %18s %18s\n", "readers", "separate Mitems/s", "interleaved",
+		    "tagged");
+		for (uint32_t readers = 1; readers <= maxReaders; readers *= 2)
+		{
+				printf("%8u %18.2f %18.2f %18.2f\n", readers,
+				    benchRunSeparate(readers, milliseconds) / 1e6,
+				    benchRunInterleaved(readers, milliseconds) / 1e6,
+				    benchRunTagged(readers, milliseconds) / 1e6);
+		}
+		return 0;
+}
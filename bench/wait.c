@@ -0,0 +1,123 @@
+// Cost of "TSblockingpipe": an uncontended push and pop against the plain "TSpipe", then
+// for every wait strategy the CPU time a reader burns waiting on an idle pipe, and the
+// latency from a push to the waiting reader having the element.
+//
+// Usage: pipe_bench_wait [wake-ups]
+
+#include "./bench.h"
+#include "../pipe_wait.h"
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, uint64_t, 6)
+TS_PIPE_DEFINE_BLOCKING(TSbenchblockingpipe, tsBenchBlockingPipe, TSbenchpipe, tsBenchPipe,
+    uint64_t)
+
+enum
+{
+		BENCH_IDLE_MS = 500
+};
+
+static TSbenchblockingpipe benchPipe;
+static uint64_t *latencies;
+static uint64_t idleCpuNs;
+
+static uint64_t
+benchThreadCpuNow(void)
+{
+		struct timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/// Wait through the idle period, then time every wake-up until the pipe is closed.
+static void *
+benchReader(void *arg)
+{
+		uint64_t stamp;
+		uint64_t count = 0;
+		(void)arg;
+
+		uint64_t cpu = benchThreadCpuNow();
+		tsBenchBlockingPipeReaderReadBack(&benchPipe, &stamp);
+		idleCpuNs = benchThreadCpuNow() - cpu;
+
+		while (tsBenchBlockingPipeReaderReadBack(&benchPipe, &stamp))
+		{
+				latencies[count++] = tsBenchNow() - stamp;
+		}
+		return NULL;
+}
+
+static int
+benchCompare(const void *a, const void *b)
+{
+		uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+		return x < y ? -1 : x > y;
+}
+
+/// Nanoseconds per push and pop by the writer alone, with or without the event count.
+static double
+benchPushPop(int blocking)
+{
+		const uint64_t rounds = 20000000;
+		uint64_t value = 0;
+		uint64_t start = tsBenchNow();
+		for (uint64_t i = 0; i < rounds; ++i)
+		{
+				if (blocking) tsBenchBlockingPipeWriterTryWriteFront(&benchPipe, &i);
+				else tsBenchPipeWriterTryWriteFront(&benchPipe.pipe, &i);
+				tsBenchPipeWriterTryReadFront(&benchPipe.pipe, &value);
+				TS_BENCH_KEEP(value);
+		}
+		return (double)(tsBenchNow() - start) / (double)rounds;
+}
+
+static void
+benchStrategy(const char *name, TSwaitstrategy strategy, uint32_t wakes)
+{
+		pthread_t reader;
+		uint64_t stamp;
+
+		tsBenchBlockingPipeInit(&benchPipe);
+		tsBenchBlockingPipeSetWaitStrategy(&benchPipe, strategy);
+		pthread_create(&reader, NULL, benchReader, NULL);
+		tsBenchSleep(BENCH_IDLE_MS);
+		stamp = tsBenchNow();
+		tsBenchBlockingPipeWriterTryWriteFront(&benchPipe, &stamp);
+
+		// Give the reader time to go back to waiting before every push.
+		for (uint32_t i = 0; i < wakes; ++i)
+		{
+				tsBenchSleep(1);
+				stamp = tsBenchNow();
+				tsBenchBlockingPipeWriterTryWriteFront(&benchPipe, &stamp);
+		}
+		tsBenchSleep(1);
+		tsBenchBlockingPipeClose(&benchPipe);
+		pthread_join(reader, NULL);
+		tsBenchBlockingPipeDestroy(&benchPipe);
+
+		qsort(latencies, wakes, sizeof(uint64_t), benchCompare);
+		printf("%-8s idle CPU %6.1f%%, wake-up p50 %8.2f us, p99 %8.2f us, max %8.2f us\n", name,
+		    (double)idleCpuNs / (BENCH_IDLE_MS * 1e4), (double)latencies[wakes / 2] / 1e3,
+		    (double)latencies[wakes * 99 / 100] / 1e3, (double)latencies[wakes - 1] / 1e3);
+}
+
+int
+main(int argc, char **argv)
+{
+		uint32_t wakes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000;
+
+		tsBenchBlockingPipeInit(&benchPipe);
+		double plain = benchPushPop(0);
+		double blocking = benchPushPop(1);
+		printf("push + pop: plain %.2f ns, blocking %.2f ns\n", plain, blocking);
+
+		latencies = (uint64_t *)malloc(wakes * sizeof(uint64_t));
+		benchStrategy("spin", tsWaitSpin(), wakes);
+		benchStrategy("backoff", tsWaitBackoff(1024), wakes);
+		benchStrategy("yield", tsWaitYield(), wakes);
+		benchStrategy("park", tsWaitPark(TS_PIPE_WAIT_SPIN_COUNT, TS_WAIT_FOREVER), wakes);
+		benchStrategy("park 1ms", tsWaitPark(TS_PIPE_WAIT_SPIN_COUNT, 1000000), wakes);
+		free(latencies);
+		return 0;
+}
@@ -0,0 +1,70 @@
+// Writer throughput of "tsPipeWriterTryWriteFrontN" against a loop of
+// "tsPipeWriterTryWriteFront", for bursts of several sizes.
+//
+// Usage: pipe_bench_write_batch [items]
+
+#include "./bench.h"
+#include "../pipe.h"
+
+enum
+{
+		BENCH_PIPE_SIZE_LOG2 = 12,
+		BENCH_PIPE_SIZE = 1 << BENCH_PIPE_SIZE_LOG2
+};
+
+TS_PIPE_DEFINE(TSbenchpipe, tsBenchPipe, uint64_t, BENCH_PIPE_SIZE_LOG2)
+
+static TSbenchpipe pipe;
+static uint64_t items[BENCH_PIPE_SIZE];
+
+/// Write "total" elements in bursts of "burst" and return the elements written per second.
+/// Only the writes are timed, the pipe is drained whenever the next round would not fit.
+static double
+benchWrite(uint64_t total, uint32_t burst, int batched)
+{
+		uint64_t elapsed = 0;
+		uint64_t written = 0;
+		uint32_t bursts = BENCH_PIPE_SIZE / burst;
+
+		tsBenchPipeInit(&pipe);
+		while (written < total)
+		{
+				uint64_t start = tsBenchNow();
+				for (uint32_t b = 0; b < bursts; ++b)
+				{
+						if (batched) { written += tsBenchPipeWriterTryWriteFrontN(&pipe, items, burst); }
+						else
+						{
+								for (uint32_t i = 0; i < burst; ++i)
+								{
+										written += tsBenchPipeWriterTryWriteFront(&pipe, &items[i]);
+								}
+						}
+				}
+				elapsed += tsBenchNow() - start;
+
+				uint64_t out;
+				while (tsBenchPipeReaderTryReadBack(&pipe, &out)) { TS_BENCH_KEEP(out); }
+		}
+
+		return (double)written * 1e9 / (double)elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+		static const uint32_t bursts[] = {1, 4, 16, 64, 256};
+		uint64_t total = argc > 1 ? strtoull(argv[1], NULL, 10) : 50000000;
+
+		for (uint32_t i = 0; i < BENCH_PIPE_SIZE; ++i) items[i] = i;
+
+		printf("%8s %20s %20s %8s\n", "burst", "single (Mitems/s)", "batched (Mitems/s)", "gain");
+		for (size_t i = 0; i < sizeof(bursts) / sizeof(bursts[0]); ++i)
+		{
+				double single = benchWrite(total, bursts[i], 0);
+				double batched = benchWrite(total, bursts[i], 1);
+				printf("%8u %20.1f %20.1f %7.2fx\n", bursts[i], single / 1e6, batched / 1e6,
+				    batched / single);
+		}
+		return 0;
+}
@@ -7,21 +7,24 @@ extern "C" {
 
 #include <stdint.h>
 #include <stddef.h>
-//#include <stdlib.h>
-//#include <string.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifndef TS_PIPE_DATA_TYPE
 #		define TS_PIPE_DATA_TYPE unsigned int
 #endif // TS_PIPE_DATA_TYPE
 
 #ifndef TS_STATIC_ASSERT
-#		if __STDC_VERSION__ == 201112L
+#		if defined __cplusplus && __cplusplus >= 201103L
+#				define TS_STATIC_ASSERT static_assert
+#		elif defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L
 /// _Static_assert of C11.
 #				define TS_STATIC_ASSERT _Static_assert // static_assert can be used in both c/c++.
 #		else
 // Simple substitution for static assert.
 /// Final implementation.
-#				define TS_STATIC_ASSERT2_(cond, msg, name) static char __check__##name[cond ? 1 : -1]
+#				define TS_STATIC_ASSERT2_(cond, msg, name) \
+				    static char __check__##name[(cond) ? 1 : -1] __attribute__((unused))
 /// Middle layer to unfold "__LINE__".
 #				define TS_STATIC_ASSERT_(cond, msg, name)  TS_STATIC_ASSERT2_(cond, msg, name)
 /// Entry of static assert.
@@ -29,132 +32,479 @@ extern "C" {
 #		endif
 #endif // TS_STATIC_ASSERT
 
+#ifndef TS_PIPE_CACHE_LINE_SIZE
+/// Assumed size of a cache line, 128 also keeps the adjacent-line prefetcher out of the way.
+#		define TS_PIPE_CACHE_LINE_SIZE 64
+#endif // TS_PIPE_CACHE_LINE_SIZE
+
+// Define "TS_PIPE_ISOLATE_INDICES" to give the writer-owned indices ("writeIndex" and
+// "readIndex") and the reader-shared "readCount" a cache line each. Otherwise the writer
+// pushing and the thieves bumping "readCount" keep stealing the same line from each other,
+// at the cost of two lines more per pipe. Pipes then need "TS_PIPE_CACHE_LINE_SIZE"
+// aligned storage.
+#ifdef TS_PIPE_ISOLATE_INDICES
+#		define TS_PIPE_INDEX_ALIGN_ __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE)))
+#else
+#		define TS_PIPE_INDEX_ALIGN_ __attribute__((aligned(4)))
+#endif // TS_PIPE_ISOLATE_INDICES
+
+// Define "TS_PIPE_SIMD_SCAN" to have a reader that lost a flag to another thread look at
+// the next 32 (AVX2) or 16 (SSE2) bytes of flags at once and try the first readable one,
+// instead of trying them one by one. Long walks past claimed flags happen with many
+// readers. Without AVX2 nor SSE2, with interleaved slots, or where the flags wrap around,
+// readers walk one flag at a time as usual.
+#ifdef TS_PIPE_SIMD_SCAN
+#		if defined __AVX2__
+#				include <immintrin.h>
+#				define TS_PIPE_SCAN_BYTES_ 32
+#		elif defined __SSE2__
+#				include <emmintrin.h>
+#				define TS_PIPE_SCAN_BYTES_ 16
+#		endif
+#endif // TS_PIPE_SIMD_SCAN
+
+// Define "TS_PIPE_COMPACT_FLAGS" to make flags a byte instead of four, so the flags of a
+// default pipe take 256 bytes instead of 1 KB and more of many busy pipes stays in cache.
+// Byte compare exchanges cost the same as 32-bit ones.
+
 #include "./pipe_atomic.h"
 
 enum
 {
 		TS_PIPE_SIZE_LOG2 = 8,
-		TS_PIPE_SIZE = 2 << TS_PIPE_SIZE_LOG2,
+		TS_PIPE_SIZE = 1 << TS_PIPE_SIZE_LOG2,
 		TS_PIPE_MASK = TS_PIPE_SIZE - 1,
+
+		// Every byte of a flag has the same value, see "tsPipeViewNextReadable_".
+#ifdef TS_PIPE_COMPACT_FLAGS
+		TS_PIPE_READABLE = 0x11,
+		TS_PIPE_WRITABLE = 0x00,
+		TS_PIPE_INVALID = 0xFF
+#else
 		TS_PIPE_READABLE = 0x11111111,
 		TS_PIPE_WRITABLE = 0x00000000,
 		TS_PIPE_INVALID = 0xFFFFFFFF
+#endif // TS_PIPE_COMPACT_FLAGS
 };
 
 TS_STATIC_ASSERT(TS_PIPE_SIZE_LOG2 < 32, "");
 
 typedef TS_PIPE_DATA_TYPE TSpipedata;
 
-struct TSpipe
+/// State of a slot, "TS_PIPE_READABLE", "TS_PIPE_WRITABLE" or "TS_PIPE_INVALID".
+#ifdef TS_PIPE_COMPACT_FLAGS
+typedef uint8_t TSpipeflag;
+#else
+typedef uint32_t TSpipeflag;
+#endif // TS_PIPE_COMPACT_FLAGS
+
+static inline TSpipeflag __attribute__((always_inline))
+tsPipeFlagLoad(const TSpipeflag volatile *flag, enum TSmemorder order)
+{
+#ifdef TS_PIPE_COMPACT_FLAGS
+		return tsAtomicLoad_u8(flag, order);
+#else
+		return tsAtomicLoad_u32(flag, order);
+#endif // TS_PIPE_COMPACT_FLAGS
+}
+
+static inline void __attribute__((always_inline))
+tsPipeFlagStore(TSpipeflag volatile *flag, TSpipeflag value, enum TSmemorder order)
+{
+#ifdef TS_PIPE_COMPACT_FLAGS
+		tsAtomicStore_u8(flag, value, order);
+#else
+		tsAtomicStore_u32(flag, value, order);
+#endif // TS_PIPE_COMPACT_FLAGS
+}
+
+static inline int __attribute__((always_inline)) tsPipeFlagCmpXchg(
+    TSpipeflag volatile *flag,
+    const TSpipeflag *expected,
+    const TSpipeflag *desired,
+    int weak,
+    enum TSmemorder successOrder,
+    enum TSmemorder failureOrder)
+{
+#ifdef TS_PIPE_COMPACT_FLAGS
+		return tsAtomicCmpXchg_u8(flag, expected, desired, weak, successOrder, failureOrder);
+#else
+		return tsAtomicCmpXchg_u32(flag, expected, desired, weak, successOrder, failureOrder);
+#endif // TS_PIPE_COMPACT_FLAGS
+}
+
+enum
 {
-		/// Data of the pipe.
-		TSpipedata buffer[TS_PIPE_SIZE];
+		TS_DYNPIPE_OWNS_BUFFER = 1 << 0,
+		TS_DYNPIPE_OWNS_FLAGS = 1 << 1
+};
 
-		// Volatile means "easy to change" and can be consiedered as "direct access to raw
-		// memory addresses". "Volatile" is caused by external factors, such as
-		// multithreading, interruptions, etc.
+// Contention counters --------------------------------------------------------------------
+//
+// Define "TS_PIPE_STATS" to have every thread count what happens in the "tsPipeView*"
+// functions it calls, and "tsPipeStatsCollect" to add up the counts of all threads. Every
+// thread only ever writes its own counters, with plain loads and stores, so counting costs
+// no atomic read-modify-write nor shared cache line. Without "TS_PIPE_STATS" the counting
+// compiles to nothing.
 
-		/// Can be "TS_PIPE_INVALID", "TS_PIPE_READABLE" and "TS_PIPE_WRITABLE"
-		uint32_t volatile flags[TS_PIPE_SIZE];
+#ifdef TS_PIPE_STATS
+#		include <pthread.h>
+#endif // TS_PIPE_STATS
 
-		// Not like std::atomic in c++11, usually we need to align data in (double) word
-		// to make it atomic.
-		// Notice that increment/decrement operations(like a++, --a) and compound assignment
-		// operations(like a=1, a+=2, c<<=3) are read-modify-write atomic operations with
-		// total sequentially consistent ordering (as if using TS_SEQ_CST).
-		// __attribute__ directive:
-		// https://gcc.gnu.org/onlinedocs/gcc-3.2/gcc/Variable-Attributes.html C11 _Atomic:
-		// https://en.cppreference.com/w/c/language/atomic.
+struct TSpipestats
+{
+		/// Elements claimed by readers, and calls that found nothing to claim.
+		uint64_t readerReads;
+		uint64_t readerEmpty;
+
+		/// Flags readers tried to claim, tries lost to another thread, and walks past the write
+		/// index that had to start over from the read index.
+		uint64_t readerProbes;
+		uint64_t readerCasFailures;
+		uint64_t readerRestarts;
 
-		/// Changed in "tsPipeWriterTryWriteFront" and "tsPipeWriterTryReadFront".
-		uint32_t volatile writeIndex __attribute__((aligned(4)));
+		/// Most flags a single reader call tried before it claimed an element.
+		uint64_t readerLongestWalk;
 
-		/// Changed only in "tsPipeWriterTryReadFront".
-		uint32_t volatile readIndex __attribute__((aligned(4)));
+		/// Elements written, and writes that found the pipe full.
+		uint64_t writerPushes;
+		uint64_t writerFull;
 
-		/// Counts of total already read buffers. Written only in "tsPipeReaderTryReadBack" to
-		/// indicate a chunk of buffer has been successfull read.
-		uint32_t volatile readCount __attribute__((aligned(4)));
+		/// Elements the writer took back from the front, calls that found the pipe empty,
+		/// flags it lost to readers, and calls that gave up because readers had taken the rest.
+		uint64_t writerPops;
+		uint64_t writerPopEmpty;
+		uint64_t writerPopCasFailures;
+		uint64_t writerPopLost;
 };
 
-typedef struct TSpipe TSpipe;
+typedef struct TSpipestats TSpipestats;
+
+#ifdef TS_PIPE_STATS
+
+/// Counters of a thread, reused by a later thread once the thread exits so that they are
+/// never lost nor freed.
+struct TSpipestatsnode
+{
+		TSpipestats stats;
+		struct TSpipestatsnode *next;
+		int inUse;
+};
+
+// Weak, so that every translation unit including this header shares them.
+__attribute__((weak)) __thread TSpipestats *tsPipeStatsThread_;
+__attribute__((weak)) struct TSpipestatsnode *tsPipeStatsNodes_;
+__attribute__((weak)) pthread_mutex_t tsPipeStatsLock_ = PTHREAD_MUTEX_INITIALIZER;
+__attribute__((weak)) pthread_once_t tsPipeStatsOnce_ = PTHREAD_ONCE_INIT;
+__attribute__((weak)) pthread_key_t tsPipeStatsKey_;
 
-/// Initialize the pipe. Except "buffer" field, clear the other bytes of the pipe.
 static inline void
-tsPipeInit(TSpipe *pipe)
+tsPipeStatsDetach_(void *node)
+{
+		pthread_mutex_lock(&tsPipeStatsLock_);
+		((struct TSpipestatsnode *)node)->inUse = 0;
+		pthread_mutex_unlock(&tsPipeStatsLock_);
+}
+
+static inline void
+tsPipeStatsCreateKey_(void)
+{
+		pthread_key_create(&tsPipeStatsKey_, tsPipeStatsDetach_);
+}
+
+static inline TSpipestats *__attribute__((cold))
+tsPipeStatsAttach_(void)
+{
+		struct TSpipestatsnode *node;
+		pthread_once(&tsPipeStatsOnce_, tsPipeStatsCreateKey_);
+
+		pthread_mutex_lock(&tsPipeStatsLock_);
+		for (node = tsPipeStatsNodes_; node && node->inUse; node = node->next) {}
+		if (!node)
+		{
+				node = (struct TSpipestatsnode *)calloc(1, sizeof(struct TSpipestatsnode));
+				if (!node) abort();
+				node->next = tsPipeStatsNodes_;
+				tsPipeStatsNodes_ = node;
+		}
+		node->inUse = 1;
+		pthread_mutex_unlock(&tsPipeStatsLock_);
+
+		pthread_setspecific(tsPipeStatsKey_, node);
+		tsPipeStatsThread_ = &node->stats;
+		return &node->stats;
+}
+
+static inline TSpipestats *__attribute__((always_inline))
+tsPipeStatsLocal_(void)
+{
+		TSpipestats *stats = tsPipeStatsThread_;
+		if (__builtin_expect(stats == NULL, 0)) stats = tsPipeStatsAttach_();
+		return stats;
+}
+
+// Relaxed atomic loads and stores are plain moves, they only keep "tsPipeStatsCollect"
+// from reading torn values.
+static inline void __attribute__((always_inline))
+tsPipeStatsAdd_(uint64_t *counter, uint64_t n)
+{
+		uint64_t count = __atomic_load_n(counter, __ATOMIC_RELAXED);
+		__atomic_store_n(counter, count + n, __ATOMIC_RELAXED);
+}
+
+static inline void __attribute__((always_inline))
+tsPipeStatsMax_(uint64_t *counter, uint64_t n)
+{
+		if (n > __atomic_load_n(counter, __ATOMIC_RELAXED))
+		{
+				__atomic_store_n(counter, n, __ATOMIC_RELAXED);
+		}
+}
+
+/// Sum of the counters of every thread that ever counted, the longest walk is the longest
+/// of all.
+static inline TSpipestats
+tsPipeStatsCollect(void)
+{
+		TSpipestats sum;
+		memset(&sum, 0, sizeof(sum));
+
+		pthread_mutex_lock(&tsPipeStatsLock_);
+		for (struct TSpipestatsnode *node = tsPipeStatsNodes_; node; node = node->next)
+		{
+				uint64_t *from = (uint64_t *)&node->stats;
+				uint64_t *to = (uint64_t *)&sum;
+				for (size_t i = 0; i < sizeof(TSpipestats) / sizeof(uint64_t); ++i)
+				{
+						if (&to[i] == &sum.readerLongestWalk)
+						{
+								tsPipeStatsMax_(&to[i], __atomic_load_n(&from[i], __ATOMIC_RELAXED));
+						}
+						else { to[i] += __atomic_load_n(&from[i], __ATOMIC_RELAXED); }
+				}
+		}
+		pthread_mutex_unlock(&tsPipeStatsLock_);
+		return sum;
+}
+
+#		define TS_PIPE_STATS_ONLY_(...)    __VA_ARGS__
+#		define TS_PIPE_STAT_ADD_(field, n) tsPipeStatsAdd_(&tsPipeStatsLocal_()->field, (n))
+#		define TS_PIPE_STAT_MAX_(field, n) tsPipeStatsMax_(&tsPipeStatsLocal_()->field, (n))
+#else
+#		define TS_PIPE_STATS_ONLY_(...)
+#		define TS_PIPE_STAT_ADD_(field, n) ((void)0)
+#		define TS_PIPE_STAT_MAX_(field, n) ((void)0)
+#endif // TS_PIPE_STATS
+
+#include "./pipe_trace.h"
+
+/// Where a pipe keeps its data, flags and indices. Every pipe type builds one on the fly
+/// and hands it to the "tsPipeView*" functions, so the lock-free protocol is written only
+/// once. All of them are inlined, constant masks and element sizes are folded away.
+struct TSpipeview
 {
-		memset(pipe->buffer, 0, sizeof(pipe->buffer));
-		pipe->readIndex = 0;
-		pipe->writeIndex = 0;
-		pipe->readCount = 0;
+		/// First element of the data buffer.
+		unsigned char *buffer;
+
+		/// First flag, see "TS_PIPE_DEFINE".
+		unsigned char *flags;
+
+		/// Size of an element in bytes.
+		size_t size;
+
+		/// Distance in bytes between two elements and between two flags. Elements and flags live
+		/// in arrays of their own, or interleaved in an array of slots (see
+		/// "TS_PIPE_DEFINE_INTERLEAVED").
+		size_t stride;
+		size_t flagStride;
+
+		/// Number of elements minus one, the number of elements is always a power of two.
+		uint32_t mask;
+
+		uint32_t volatile *writeIndex;
+		uint32_t volatile *readIndex;
+		uint32_t volatile *readCount;
+};
+
+typedef struct TSpipeview TSpipeview;
+
+static inline TSpipeflag volatile *__attribute__((always_inline))
+tsPipeViewFlag(TSpipeview view, uint32_t slot)
+{
+		return (TSpipeflag volatile *)(view.flags + slot * view.flagStride);
+}
+
+static inline unsigned char *__attribute__((always_inline))
+tsPipeViewElement(TSpipeview view, uint32_t slot)
+{
+		return view.buffer + slot * view.stride;
 }
 
 /// Not intended for general use. Should only be used very prudently.
-static inline int
-tsPipeIsEmpty(TSpipe *pipe)
+static inline int __attribute__((always_inline))
+tsPipeViewIsEmpty(TSpipeview view)
 {
-		return tsAtomicLoad_u32(&pipe->writeIndex, TS_RELAXED) -
-		           tsAtomicLoad_u32(&pipe->readCount, TS_RELAXED) ==
+		return tsAtomicLoad_u32(view.writeIndex, TS_RELAXED) -
+		           tsAtomicLoad_u32(view.readCount, TS_RELAXED) ==
 		       0;
 }
 
-/// Return 0 if we were unable to read.
+/// First index from "index" on, up to "end", whose flag looks readable, or the index after
+/// the last flag looked at. Flags are loaded a vector at a time without atomics (every
+/// lane is still read whole), so the answer is a hint only the compare exchange can
+/// confirm. Without "TS_PIPE_SCAN_BYTES_" it is "index", every flag is tried in turn.
+static inline uint32_t __attribute__((always_inline))
+tsPipeViewNextReadable_(TSpipeview view, uint32_t index, uint32_t end)
+{
+#ifdef TS_PIPE_SCAN_BYTES_
+		const uint32_t width = TS_PIPE_SCAN_BYTES_ / sizeof(TSpipeflag);
+		uint32_t slot = index & view.mask;
+		if (index >= end || view.flagStride != sizeof(TSpipeflag) || slot + width > view.mask + 1)
+		{
+				return index;
+		}
+
+		// Flags at and past "end" belong to the previous lap, they may well be readable.
+		uint32_t lanes = end - index < width ? end - index : width;
+
+		// Bytes are compared, whatever the size of a flag: all of its bytes hold the same value,
+		// so the first matching byte is the first one of a readable flag.
+		const void *flags = (const void *)tsPipeViewFlag(view, slot);
+#		if TS_PIPE_SCAN_BYTES_ == 32
+		__m256i readable = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)flags),
+		    _mm256_set1_epi8((char)(TS_PIPE_READABLE & 0xFF)));
+		uint32_t bits = (uint32_t)_mm256_movemask_epi8(readable);
+#		else
+		__m128i readable = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)flags),
+		    _mm_set1_epi8((char)(TS_PIPE_READABLE & 0xFF)));
+		uint32_t bits = (uint32_t)_mm_movemask_epi8(readable);
+#		endif
+		bits &= (uint32_t)(((uint64_t)1 << (lanes * sizeof(TSpipeflag))) - 1);
+		if (!bits) return index + lanes;
+		return index + (uint32_t)(__builtin_ctz(bits) / sizeof(TSpipeflag));
+#else
+		(void)view;
+		(void)end;
+		return index;
+#endif // TS_PIPE_SCAN_BYTES_
+}
+
+/// Claim up to "n" of the oldest readable elements, but no more than half of the elements
+/// in the pipe (rounded up, so a lone element can still be taken). On success the elements
+/// at "(*slot + i) & mask", "i" below the returned count, belong to the caller until each of
+/// them is handed to "tsPipeViewReaderReleaseBack". Return 0 if we were unable to read.
 /// Thread safe for both multiple readers and the writer.
-static int
-tsPipeReaderTryReadBack(TSpipe *pipe, TSpipedata *out)
+static inline uint32_t __attribute__((always_inline))
+tsPipeViewReaderClaimBackN(TSpipeview view, uint32_t *slot, uint32_t n)
 {
-		uint32_t actualReadIndex;
-		uint32_t readCount = tsAtomicLoad_u32(&pipe->readCount, TS_RELAXED);
+		uint32_t writeIndex;
+		uint32_t numInPipe;
+		uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+		TS_PIPE_STATS_ONLY_(uint64_t walk = 0;)
 
 		// We get hold of read index for consistency and do first pass starting at read count.
 		uint32_t readIndexToUse = readCount;
 		while (1)
 		{
-				uint32_t writeIndex = tsAtomicLoad_u32(&pipe->writeIndex, TS_RELAXED);
-				uint32_t numInPipe = writeIndex - readCount;
-				if (0 == numInPipe) { return 0; }
+				writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+				numInPipe = writeIndex - readCount;
+				if (0 == numInPipe || 0 == n)
+				{
+						TS_PIPE_STAT_ADD_(readerEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_STEAL_EMPTY, 0);
+						return 0;
+				}
 
 				if (readIndexToUse >= writeIndex)
 				{
-						readIndexToUse = tsAtomicLoad_u32(&pipe->readIndex, TS_RELAXED);
+						TS_PIPE_STAT_ADD_(readerRestarts, 1);
+						readIndexToUse = tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
 				}
 
-				actualReadIndex = readIndexToUse & TS_PIPE_MASK;
+				uint32_t actualReadIndex = readIndexToUse & view.mask;
 
 				// Multiple potential readers mean we should check if the data is valid,
 				// using an atomic compare exchange.
-				uint32_t expected = TS_PIPE_READABLE;
-				uint32_t desired = TS_PIPE_INVALID;
-				TSbool success = tsAtomicCmpXchg_u32(
-				    &pipe->flags[actualReadIndex], &expected, &desired, 1, TS_ACQ_REL, TS_RELAXED);
+				TSpipeflag expected = TS_PIPE_READABLE;
+				TSpipeflag desired = TS_PIPE_INVALID;
+				TSbool success = tsPipeFlagCmpXchg(tsPipeViewFlag(view, actualReadIndex),
+				    &expected, &desired, 1, TS_ACQ_REL, TS_RELAXED);
+				TS_PIPE_STATS_ONLY_(++walk;)
 				if (success) break;
+				TS_PIPE_STAT_ADD_(readerCasFailures, 1);
 
-				// Proceed to previous data (towards pipe->writeIndex, which is the head).
-				++readIndexToUse;
+				// Proceed to previous data (towards pipe->writeIndex, which is the head), skipping
+				// what is claimed already if we can tell at a glance.
+				readIndexToUse = tsPipeViewNextReadable_(view, readIndexToUse + 1, writeIndex);
 
 				// Update read count.
-				readCount = tsAtomicLoad_u32(&pipe->readCount, TS_RELAXED);
+				readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
 		}
 
-		// We update the read index using an atomic add, as we've only read one piece of data.
+		// The first element is ours, keep taking the ones right after it until we have our
+		// share or another reader got there first.
+		uint32_t wanted = (numInPipe + 1) / 2;
+		if (wanted > n) wanted = n;
+		uint32_t claimed = 1;
+		for (; claimed < wanted && readIndexToUse + claimed < writeIndex; ++claimed)
+		{
+				TSpipeflag expected = TS_PIPE_READABLE;
+				TSpipeflag desired = TS_PIPE_INVALID;
+				uint32_t actualReadIndex = (readIndexToUse + claimed) & view.mask;
+				TSbool success = tsPipeFlagCmpXchg(tsPipeViewFlag(view, actualReadIndex),
+				    &expected, &desired, 0, TS_ACQ_REL, TS_RELAXED);
+				if (!success) break;
+		}
+
+		// We update the read index using a single atomic add, however much data we've read.
 		// this ensure consistency of the read index, and the above loop ensures readers
 		// only read from unread data.
-		tsAtomicFetchAdd_u32(&pipe->readCount, 1, TS_RELAXED);
+		tsAtomicFetchAdd_u32(view.readCount, claimed, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(readerReads, claimed);
+		TS_PIPE_STAT_ADD_(readerProbes, walk + claimed - 1);
+		TS_PIPE_STAT_MAX_(readerLongestWalk, walk);
+		TS_TRACE_EVENT_(TS_TRACE_STEAL, claimed);
 
-		// Now read data, ensuring we do so after above reads & CAS.
-		*out = pipe->buffer[actualReadIndex];
+		*slot = readIndexToUse & view.mask;
+		return claimed;
+}
 
-		tsAtomicStore_u32(&pipe->flags[actualReadIndex], TS_PIPE_WRITABLE, TS_RELEASE);
+/// Claim the oldest readable element. On success the element at "*slot" belongs to the
+/// caller until "tsPipeViewReaderReleaseBack". Return 0 if we were unable to read.
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsPipeViewReaderClaimBack(TSpipeview view, uint32_t *slot)
+{
+		return tsPipeViewReaderClaimBackN(view, slot, 1) != 0;
+}
 
-		return 1;
+/// Hand an element claimed by "tsPipeViewReaderClaimBack" back to the writer.
+static inline void __attribute__((always_inline))
+tsPipeViewReaderReleaseBack(TSpipeview view, uint32_t slot)
+{
+		tsPipeFlagStore(tsPipeViewFlag(view, slot), TS_PIPE_WRITABLE, TS_RELEASE);
+}
+
+/// Whether the writer has come within "slack" slots of the element claimed at "slot". It
+/// can not write past a claimed element, so a reader holding one for long should let go of
+/// it once this returns 1, and at the latest when the writer is right behind it.
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsPipeViewReaderClaimExpired(TSpipeview view, uint32_t slot, uint32_t slack)
+{
+		// Claimed elements are behind the write index by 1 up to the whole pipe.
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+		uint32_t distance = ((writeIndex - slot - 1) & view.mask) + 1;
+		return distance + slack > view.mask;
 }
 
-/// "tsPipeWriterTryReadFront" returns 0 if we were unable to read.
+/// Claim the newest element. On success the element at "*slot" belongs to the caller until
+/// "tsPipeViewWriterReleaseFront". Return 0 if we were unable to read.
 /// This is thread safe for the single writer, but should not be called by readers.
-static int
-tsPipeWriterTryReadFront(TSpipe *pipe, TSpipedata *out)
+static inline int __attribute__((always_inline))
+tsPipeViewWriterClaimFront(TSpipeview view, uint32_t *slot)
 {
-		uint32_t writeIndex = tsAtomicLoad_u32(&pipe->writeIndex, TS_RELAXED);
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
 		uint32_t frontReadIndex = writeIndex;
 
 		// Multiple potential readers mean we should check if the data is valid,
@@ -163,64 +513,477 @@ tsPipeWriterTryReadFront(TSpipe *pipe, TSpipedata *out)
 		uint32_t actualReadIndex = 0;
 		while (1)
 		{
-				uint32_t readCount = tsAtomicLoad_u32(&pipe->readCount, TS_RELAXED);
+				uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
 				uint32_t numInPipe = writeIndex - readCount;
 				if (0 == numInPipe)
 				{
-						tsAtomicStore_u32(&pipe->readIndex, readCount, TS_RELEASE);
+						TS_PIPE_STAT_ADD_(writerPopEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
+						tsAtomicStore_u32(view.readIndex, readCount, TS_RELEASE);
 						return 0;
 				}
 				--frontReadIndex;
-				actualReadIndex = frontReadIndex & TS_PIPE_MASK;
-				uint32_t expected = TS_PIPE_READABLE;
-				uint32_t desired = TS_PIPE_INVALID;
-				TSbool success = tsAtomicCmpXchg_u32(
-				    &pipe->flags[actualReadIndex], &expected, &desired, 1, TS_ACQ_REL, TS_RELAXED);
+				actualReadIndex = frontReadIndex & view.mask;
+				TSpipeflag expected = TS_PIPE_READABLE;
+				TSpipeflag desired = TS_PIPE_INVALID;
+				TSbool success = tsPipeFlagCmpXchg(tsPipeViewFlag(view, actualReadIndex),
+				    &expected, &desired, 1, TS_ACQ_REL, TS_RELAXED);
 				if (success) { break; }
-				else if (tsAtomicLoad_u32(&pipe->readIndex, TS_ACQUIRE) >= frontReadIndex)
+				TS_PIPE_STAT_ADD_(writerPopCasFailures, 1);
+				if (tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE) >= frontReadIndex)
 				{
+						TS_PIPE_STAT_ADD_(writerPopLost, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
 						return 0;
 				}
 		}
 
-		// Now read data, ensuring we do so after above reads & CAS
-		*out = pipe->buffer[actualReadIndex];
-
-		tsAtomicStore_u32(&pipe->flags[actualReadIndex], TS_PIPE_WRITABLE, TS_RELAXED);
-		tsAtomicStore_u32(&pipe->writeIndex, writeIndex - 1, TS_RELAXED);
-
+		TS_PIPE_STAT_ADD_(writerPops, 1);
+		TS_TRACE_EVENT_(TS_TRACE_POP, 1);
+		*slot = actualReadIndex;
 		return 1;
 }
 
-/// WriterTryWriteFront returns false if we were unable to write
+/// Give the element claimed by "tsPipeViewWriterClaimFront" up, shrinking the pipe by one.
+static inline void __attribute__((always_inline))
+tsPipeViewWriterReleaseFront(TSpipeview view, uint32_t slot)
+{
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+		tsPipeFlagStore(tsPipeViewFlag(view, slot), TS_PIPE_WRITABLE, TS_RELAXED);
+		tsAtomicStore_u32(view.writeIndex, writeIndex - 1, TS_RELAXED);
+}
+
+/// Find the slot the next element goes to, the caller fills it and then publishes it with
+/// "tsPipeViewWriterCommitFront". Return 0 if the pipe is full.
 /// This is thread safe for the single writer, but should not be called by readers
-static int
-tsPipeWriterTryWriteFront(TSpipe *pipe, TSpipedata *in)
+static inline int __attribute__((always_inline))
+tsPipeViewWriterReserveFront(TSpipeview view, uint32_t *slot)
 {
 		// The writer 'owns' the write index, and readers can only reduce
 		// the amount of data in the pipe.
 		// We get hold of both values for consistency and to reduce 0 sharing
 		// impacting more than one access
-		uint32_t writeIndex = pipe->writeIndex;
+		uint32_t writeIndex = *view.writeIndex;
 
 		// power of two sizes ensures we can perform AND for a modulus
-		uint32_t actualWriteIndex = writeIndex & TS_PIPE_MASK;
+		uint32_t actualWriteIndex = writeIndex & view.mask;
 
 		// a reader may still be reading this item, as there are multiple readers
-		if (tsAtomicLoad_u32(&pipe->flags[actualWriteIndex], TS_ACQUIRE) != TS_PIPE_WRITABLE)
+		if (tsPipeFlagLoad(tsPipeViewFlag(view, actualWriteIndex), TS_ACQUIRE) !=
+		    TS_PIPE_WRITABLE)
 		{
+				TS_PIPE_STAT_ADD_(writerFull, 1);
+				TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
 				return 0; // still being read, so have caught up with tail.
 		}
 
+		*slot = actualWriteIndex;
+		return 1;
+}
+
+/// Publish the element written to the slot returned by "tsPipeViewWriterReserveFront".
+static inline void __attribute__((always_inline))
+tsPipeViewWriterCommitFront(TSpipeview view, uint32_t slot)
+{
+		tsPipeFlagStore(tsPipeViewFlag(view, slot), TS_PIPE_READABLE, TS_RELEASE);
+		tsAtomicFetchAdd_u32(view.writeIndex, 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPushes, 1);
+		TS_TRACE_EVENT_(TS_TRACE_PUSH, 1);
+}
+
+/// Return 0 if we were unable to read.
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsPipeViewReaderTryReadBack(TSpipeview view, void *out)
+{
+		uint32_t slot;
+		if (!tsPipeViewReaderClaimBack(view, &slot)) return 0;
+
+		// Now read data, ensuring we do so after above reads & CAS.
+		memcpy(out, tsPipeViewElement(view, slot), view.size);
+
+		tsPipeViewReaderReleaseBack(view, slot);
+		return 1;
+}
+
+/// Steal up to "n" of the oldest elements into "out", the first one being the oldest, but no
+/// more than half of the pipe (see "tsPipeViewReaderClaimBackN"). Taking a batch per steal
+/// keeps thieves away from a deep pipe's read count for longer. Return the number of
+/// elements read, 0 if we were unable to read.
+/// Thread safe for both multiple readers and the writer.
+static inline uint32_t __attribute__((always_inline))
+tsPipeViewReaderTryReadBackHalf(TSpipeview view, void *out, uint32_t n)
+{
+		uint32_t first;
+		uint32_t claimed = tsPipeViewReaderClaimBackN(view, &first, n);
+
+		// Hand every element back as soon as it is copied, the writer may be waiting for it.
+		for (uint32_t i = 0; i < claimed; ++i)
+		{
+				uint32_t slot = (first + i) & view.mask;
+				memcpy((unsigned char *)out + (size_t)i * view.size,
+				    tsPipeViewElement(view, slot),
+				    view.size);
+				tsPipeViewReaderReleaseBack(view, slot);
+		}
+		return claimed;
+}
+
+/// "tsPipeViewWriterTryReadFront" returns 0 if we were unable to read.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsPipeViewWriterTryReadFront(TSpipeview view, void *out)
+{
+		uint32_t slot;
+		if (!tsPipeViewWriterClaimFront(view, &slot)) return 0;
+
+		// Now read data, ensuring we do so after above reads & CAS
+		memcpy(out, tsPipeViewElement(view, slot), view.size);
+
+		tsPipeViewWriterReleaseFront(view, slot);
+		return 1;
+}
+
+/// WriterTryWriteFront returns false if we were unable to write
+/// This is thread safe for the single writer, but should not be called by readers
+static inline int __attribute__((always_inline))
+tsPipeViewWriterTryWriteFront(TSpipeview view, const void *in)
+{
+		uint32_t slot;
+		if (!tsPipeViewWriterReserveFront(view, &slot)) return 0;
+
 		// as we are the only writer we can update the data without atomics
 		//  whilst the write index has not been updated
-		pipe->buffer[actualWriteIndex] = *in;
-		tsAtomicStore_u32(&pipe->flags[actualWriteIndex], TS_PIPE_READABLE, TS_RELEASE);
+		memcpy(tsPipeViewElement(view, slot), in, view.size);
 
-		tsAtomicFetchAdd_u32(&pipe->writeIndex, 1, TS_RELAXED);
+		tsPipeViewWriterCommitFront(view, slot);
 		return 1;
 }
 
+/// Write up to "n" elements of "in" in one go, the first one being the oldest. Fill as many
+/// slots as are free and publish all of them with a single update of the write index, so a
+/// burst costs one atomic read-modify-write instead of one per element. Return the number
+/// of elements written, 0 if the pipe is full.
+/// This is thread safe for the single writer, but should not be called by readers
+static inline uint32_t __attribute__((always_inline))
+tsPipeViewWriterTryWriteFrontN(TSpipeview view, const void *in, uint32_t n)
+{
+		uint32_t writeIndex = *view.writeIndex;
+		uint32_t written = 0;
+
+		// Readers never look at slots past the write index, so the elements may become
+		// readable one by one and still only be published at the end.
+		for (; written < n; ++written)
+		{
+				uint32_t slot = (writeIndex + written) & view.mask;
+				TSpipeflag volatile *flag = tsPipeViewFlag(view, slot);
+				if (tsPipeFlagLoad(flag, TS_ACQUIRE) != TS_PIPE_WRITABLE) break;
+				memcpy(tsPipeViewElement(view, slot),
+				    (const unsigned char *)in + (size_t)written * view.size,
+				    view.size);
+				tsPipeFlagStore(flag, TS_PIPE_READABLE, TS_RELEASE);
+		}
+
+		if (written) tsAtomicFetchAdd_u32(view.writeIndex, written, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPushes, written);
+		if (written < n) TS_PIPE_STAT_ADD_(writerFull, 1);
+		if (written) TS_TRACE_EVENT_(TS_TRACE_PUSH, written);
+		if (written < n) TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+		return written;
+}
+
+// Pipe generators -----------------------------------------------------------------------
+//
+// A pipe is made of:
+// - "buffer", the data of the pipe.
+// - "flags", one per element, can be "TS_PIPE_INVALID", "TS_PIPE_READABLE" and
+//   "TS_PIPE_WRITABLE".
+// - "writeIndex", changed in "*WriterTryWriteFront(N)" and "*WriterTryReadFront".
+// - "readIndex", changed only in "*WriterTryReadFront".
+// - "readCount", counts of total already read buffers. Written only in
+//   "*ReaderTryReadBack(Half)" to indicate a chunk of buffer has been successfull read.
+// - "claimSlack", how close the writer may come to an element a reader claimed before the
+//   claim counts as expired (see "tsPipeViewReaderClaimExpired").
+//
+// Volatile means "easy to change" and can be consiedered as "direct access to raw
+// memory addresses". "Volatile" is caused by external factors, such as
+// multithreading, interruptions, etc.
+//
+// Not like std::atomic in c++11, usually we need to align data in (double) word
+// to make it atomic.
+// Notice that increment/decrement operations(like a++, --a) and compound assignment
+// operations(like a=1, a+=2, c<<=3) are read-modify-write atomic operations with
+// total sequentially consistent ordering (as if using TS_SEQ_CST).
+// __attribute__ directive:
+// https://gcc.gnu.org/onlinedocs/gcc-3.2/gcc/Variable-Attributes.html C11 _Atomic:
+// https://en.cppreference.com/w/c/language/atomic.
+
+/// Functions shared by every generated pipe, expects "prefix##View" to be defined.
+#define TS_PIPE_DEFINE_FUNCTIONS_(Name, prefix, type) \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsPipeViewIsEmpty(prefix##View(pipe)); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, type *out) \
+		{ \
+				return tsPipeViewReaderTryReadBack(prefix##View(pipe), out); \
+		} \
+		static inline uint32_t prefix##ReaderTryReadBackHalf(Name *pipe, type *out, uint32_t n) \
+		{ \
+				return tsPipeViewReaderTryReadBackHalf(prefix##View(pipe), out, n); \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, type *out) \
+		{ \
+				return tsPipeViewWriterTryReadFront(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, type *in) \
+		{ \
+				return tsPipeViewWriterTryWriteFront(prefix##View(pipe), in); \
+		} \
+		static inline uint32_t prefix##WriterTryWriteFrontN(Name *pipe, type *items, uint32_t n) \
+		{ \
+				return tsPipeViewWriterTryWriteFrontN(prefix##View(pipe), items, n); \
+		} \
+		/* Slot the next element goes to, NULL if the pipe is full. The writer builds the \
+		   element right there and publishes it with "prefix##WriterCommitFront", saving the \
+		   copy of "prefix##WriterTryWriteFront". */ \
+		static inline type *prefix##WriterReserveFront(Name *pipe) \
+		{ \
+				TSpipeview view = prefix##View(pipe); \
+				uint32_t slot; \
+				if (!tsPipeViewWriterReserveFront(view, &slot)) return NULL; \
+				return (type *)tsPipeViewElement(view, slot); \
+		} \
+		/* The reserved slot is the one at the write index, only the writer moves it. */ \
+		static inline void prefix##WriterCommitFront(Name *pipe) \
+		{ \
+				TSpipeview view = prefix##View(pipe); \
+				tsPipeViewWriterCommitFront(view, *view.writeIndex & view.mask); \
+		} \
+		/* Claim the oldest element, NULL if there is none. The reader works on it right in its \
+		   slot and gives it back with "prefix##ReaderReleaseBack", or copies it out with \
+		   "prefix##ReaderDetachBack" once "prefix##ReaderClaimExpired" says the writer is \
+		   getting close to it. */ \
+		static inline const type *prefix##ReaderClaimBack(Name *pipe, uint32_t *slot) \
+		{ \
+				TSpipeview view = prefix##View(pipe); \
+				if (!tsPipeViewReaderClaimBack(view, slot)) return NULL; \
+				return (const type *)tsPipeViewElement(view, *slot); \
+		} \
+		static inline int prefix##ReaderClaimExpired(Name *pipe, uint32_t slot) \
+		{ \
+				return tsPipeViewReaderClaimExpired(prefix##View(pipe), slot, pipe->claimSlack); \
+		} \
+		static inline void prefix##ReaderReleaseBack(Name *pipe, uint32_t slot) \
+		{ \
+				tsPipeViewReaderReleaseBack(prefix##View(pipe), slot); \
+		} \
+		static inline void prefix##ReaderDetachBack(Name *pipe, uint32_t slot, type *out) \
+		{ \
+				TSpipeview view = prefix##View(pipe); \
+				memcpy(out, tsPipeViewElement(view, slot), sizeof(type)); \
+				tsPipeViewReaderReleaseBack(view, slot); \
+		} \
+		/* Free slots the writer should keep ahead of claimed elements, a quarter of the pipe \
+		   by default. 0 expires claims only once the writer has to wait for them. */ \
+		static inline void prefix##SetClaimSlack(Name *pipe, uint32_t slack) \
+		{ \
+				pipe->claimSlack = slack; \
+		}
+
+/// Define pipe "Name" holding "1 << log2size" elements of "type", together with
+/// "prefix##Init", "prefix##IsEmpty", "prefix##ReaderTryReadBack",
+/// "prefix##ReaderTryReadBackHalf", "prefix##WriterTryReadFront",
+/// "prefix##WriterTryWriteFront", "prefix##WriterTryWriteFrontN",
+/// "prefix##WriterReserveFront", "prefix##WriterCommitFront", "prefix##ReaderClaimBack",
+/// "prefix##ReaderClaimExpired", "prefix##ReaderReleaseBack", "prefix##ReaderDetachBack"
+/// and "prefix##SetClaimSlack". Every pipe defined this way is an independent type, so one
+/// binary may mix pipes of different payloads and sizes.
+#define TS_PIPE_DEFINE(Name, prefix, type, log2size) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name \
+		{ \
+				type buffer[(size_t)1 << (log2size)]; \
+				TSpipeflag volatile flags[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex __attribute__((aligned(4))); \
+				uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_; \
+				uint32_t claimSlack; \
+		}; \
+		typedef struct Name Name; \
+		static inline TSpipeview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TSpipeview view; \
+				view.buffer = (unsigned char *)pipe->buffer; \
+				view.flags = (unsigned char *)pipe->flags; \
+				view.size = sizeof(type); \
+				view.stride = sizeof(type); \
+				view.flagStride = sizeof(TSpipeflag); \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndex = &pipe->readIndex; \
+				view.readCount = &pipe->readCount; \
+				return view; \
+		} \
+		/* Initialize the pipe. Except "buffer" field, clear the other bytes of the pipe. */ \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				memset((void *)pipe->flags, 0, sizeof(pipe->flags)); \
+				pipe->readIndex = 0; \
+				pipe->writeIndex = 0; \
+				pipe->readCount = 0; \
+				pipe->claimSlack = ((uint32_t)1 << (log2size)) >> 2; \
+		} \
+		TS_PIPE_DEFINE_FUNCTIONS_(Name, prefix, type)
+
+/// Like "TS_PIPE_DEFINE" but every element sits right next to its flag in an array of
+/// "struct Name##slot", so a steal touches one cache line instead of one in "flags" and
+/// one in "buffer". "TS_PIPE_DEFINE_INTERLEAVED_PADDED" also pads every slot to
+/// "TS_PIPE_CACHE_LINE_SIZE" so that neighbouring slots never share a line. Which layout
+/// wins depends on the payload size, "bench/slots.c" measures it.
+#define TS_PIPE_DEFINE_INTERLEAVED(Name, prefix, type, log2size) \
+		TS_PIPE_DEFINE_INTERLEAVED_(Name, prefix, type, log2size, )
+
+#define TS_PIPE_DEFINE_INTERLEAVED_PADDED(Name, prefix, type, log2size) \
+		TS_PIPE_DEFINE_INTERLEAVED_( \
+		    Name, prefix, type, log2size, __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))))
+
+#define TS_PIPE_DEFINE_INTERLEAVED_(Name, prefix, type, log2size, slotAttribute) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name##slot \
+		{ \
+				TSpipeflag volatile flag; \
+				type data; \
+		} slotAttribute; \
+		struct Name \
+		{ \
+				struct Name##slot slots[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex __attribute__((aligned(4))); \
+				uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_; \
+				uint32_t claimSlack; \
+		}; \
+		typedef struct Name Name; \
+		static inline TSpipeview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TSpipeview view; \
+				view.buffer = (unsigned char *)&pipe->slots[0].data; \
+				view.flags = (unsigned char *)&pipe->slots[0].flag; \
+				view.size = sizeof(type); \
+				view.stride = sizeof(struct Name##slot); \
+				view.flagStride = sizeof(struct Name##slot); \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndex = &pipe->readIndex; \
+				view.readCount = &pipe->readCount; \
+				return view; \
+		} \
+		/* Initialize the pipe. Except the elements, clear the other bytes of the pipe. */ \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				for (size_t i = 0; i < ((size_t)1 << (log2size)); ++i) \
+				{ \
+						pipe->slots[i].flag = TS_PIPE_WRITABLE; \
+				} \
+				pipe->readIndex = 0; \
+				pipe->writeIndex = 0; \
+				pipe->readCount = 0; \
+				pipe->claimSlack = ((uint32_t)1 << (log2size)) >> 2; \
+		} \
+		TS_PIPE_DEFINE_FUNCTIONS_(Name, prefix, type)
+
+/// Like "TS_PIPE_DEFINE" but the capacity is chosen by "prefix##Init", so shallow pipes
+/// stay small and deep pipes do not overflow. "prefix##Init(pipe, sizeLog2, buffer, flags)"
+/// takes storage of "1 << sizeLog2" elements owned by the caller, or NULL to allocate it
+/// (freed again by "prefix##Destroy"). The flags are cleared either way. "prefix##Init"
+/// returns 0 if the allocation failed.
+#define TS_PIPE_DEFINE_DYNAMIC(Name, prefix, type) \
+		struct Name \
+		{ \
+				type *buffer; \
+				TSpipeflag volatile *flags; \
+				uint32_t mask; \
+				uint32_t owns; /* See "TS_DYNPIPE_OWNS_*". */ \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex __attribute__((aligned(4))); \
+				uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_; \
+				uint32_t claimSlack; \
+		}; \
+		typedef struct Name Name; \
+		static inline TSpipeview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TSpipeview view; \
+				view.buffer = (unsigned char *)pipe->buffer; \
+				view.flags = (unsigned char *)pipe->flags; \
+				view.size = sizeof(type); \
+				view.stride = sizeof(type); \
+				view.flagStride = sizeof(TSpipeflag); \
+				view.mask = pipe->mask; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndex = &pipe->readIndex; \
+				view.readCount = &pipe->readCount; \
+				return view; \
+		} \
+		static inline int prefix##Init( \
+		    Name *pipe, uint32_t sizeLog2, type *buffer, TSpipeflag volatile *flags) \
+		{ \
+				size_t size; \
+				if (sizeLog2 >= 32) return 0; \
+				size = (size_t)1 << sizeLog2; \
+				pipe->owns = 0; \
+				if (!buffer) \
+				{ \
+						buffer = (type *)malloc(size * sizeof(type)); \
+						if (!buffer) return 0; \
+						pipe->owns |= TS_DYNPIPE_OWNS_BUFFER; \
+				} \
+				if (!flags) \
+				{ \
+						flags = (TSpipeflag volatile *)malloc(size * sizeof(TSpipeflag)); \
+						if (!flags) \
+						{ \
+								if (pipe->owns & TS_DYNPIPE_OWNS_BUFFER) free(buffer); \
+								return 0; \
+						} \
+						pipe->owns |= TS_DYNPIPE_OWNS_FLAGS; \
+				} \
+				memset((void *)flags, 0, size * sizeof(TSpipeflag)); \
+				pipe->buffer = buffer; \
+				pipe->flags = flags; \
+				pipe->mask = (uint32_t)(size - 1); \
+				pipe->readIndex = 0; \
+				pipe->writeIndex = 0; \
+				pipe->readCount = 0; \
+				pipe->claimSlack = (uint32_t)(size >> 2); \
+				return 1; \
+		} \
+		/* Free the storage allocated by "prefix##Init", caller-supplied storage is kept. */ \
+		static inline void prefix##Destroy(Name *pipe) \
+		{ \
+				if (pipe->owns & TS_DYNPIPE_OWNS_BUFFER) free(pipe->buffer); \
+				if (pipe->owns & TS_DYNPIPE_OWNS_FLAGS) free((void *)pipe->flags); \
+				pipe->buffer = NULL; \
+				pipe->flags = NULL; \
+				pipe->owns = 0; \
+		} \
+		/* Number of elements the pipe can hold. */ \
+		static inline uint32_t prefix##Capacity(Name *pipe) \
+		{ \
+				return pipe->mask + 1; \
+		} \
+		TS_PIPE_DEFINE_FUNCTIONS_(Name, prefix, type)
+
+/// The default pipe, "TS_PIPE_SIZE" elements of "TSpipedata". Define
+/// "TS_PIPE_INTERLEAVED_SLOTS" to give it the layout of "TS_PIPE_DEFINE_INTERLEAVED".
+#ifdef TS_PIPE_INTERLEAVED_SLOTS
+TS_PIPE_DEFINE_INTERLEAVED(TSpipe, tsPipe, TSpipedata, TS_PIPE_SIZE_LOG2)
+#else
+TS_PIPE_DEFINE(TSpipe, tsPipe, TSpipedata, TS_PIPE_SIZE_LOG2)
+#endif // TS_PIPE_INTERLEAVED_SLOTS
+
+/// The default runtime-sized pipe, elements of "TSpipedata".
+TS_PIPE_DEFINE_DYNAMIC(TSdynpipe, tsDynPipe, TSpipedata)
+
 #ifdef __cplusplus
 };
 #endif /* __cplusplus */
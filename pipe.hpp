@@ -0,0 +1,140 @@
+#ifndef PIPE_HPP
+#define PIPE_HPP
+
+// C++ face of "pipe.h". "ts::Pipe" runs the very same lock-free protocol as "TSpipe", but
+// elements are constructed in place and moved out of their slot, so move-only payloads work
+// and nothing is copied or allocated on the way.
+
+#if __cplusplus < 201703L
+#		error "pipe.hpp needs C++17 (std::optional, std::launder), or use pipe.h"
+#endif // __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "./pipe.h"
+
+namespace ts
+{
+
+/// Work-stealing pipe holding up to "N" elements of "T". The owner thread pushes and pops at
+/// the front ("try_push", "try_emplace", "try_pop"), any thread may steal from the back
+/// ("try_steal").
+template <typename T, std::uint32_t N>
+class Pipe
+{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "ts::Pipe capacity must be a power of two");
+		static_assert(N <= (std::uint32_t(1) << 31), "ts::Pipe capacity is too large");
+		static_assert(std::is_nothrow_move_constructible<T>::value,
+		    "ts::Pipe elements must be nothrow move constructible");
+		static_assert(std::is_nothrow_destructible<T>::value,
+		    "ts::Pipe elements must be nothrow destructible");
+
+public:
+		Pipe() noexcept
+		{
+				for (std::uint32_t i = 0; i < N; ++i) flags_[i] = TS_PIPE_WRITABLE;
+				writeIndex_ = 0;
+				readIndex_ = 0;
+				readCount_ = 0;
+		}
+
+		/// Destroy the remaining elements, no other thread may use the pipe any more.
+		~Pipe()
+		{
+				while (try_pop()) {}
+		}
+
+		Pipe(const Pipe &) = delete;
+		Pipe &operator=(const Pipe &) = delete;
+
+		static constexpr std::uint32_t capacity() noexcept { return N; }
+
+		/// Not intended for general use. Should only be used very prudently.
+		bool empty() noexcept { return tsPipeViewIsEmpty(view()); }
+
+		/// Construct an element in place at the front. Return false if the pipe is full.
+		/// Only the owner thread may call it.
+		template <typename... Args>
+		bool try_emplace(Args &&...args) noexcept(std::is_nothrow_constructible<T, Args...>::value)
+		{
+				TSpipeview v = view();
+				std::uint32_t slot;
+				if (!tsPipeViewWriterReserveFront(v, &slot)) return false;
+				::new (static_cast<void *>(storage_ + slot * sizeof(T))) T(std::forward<Args>(args)...);
+				tsPipeViewWriterCommitFront(v, slot);
+				return true;
+		}
+
+		/// Move "value" to the front. Return false and leave "value" alone if the pipe is full.
+		/// Only the owner thread may call it.
+		bool try_push(T &&value) noexcept { return try_emplace(std::move(value)); }
+
+		bool try_push(const T &value) noexcept(std::is_nothrow_copy_constructible<T>::value)
+		{
+				return try_emplace(value);
+		}
+
+		/// Take the newest element (LIFO). Only the owner thread may call it.
+		std::optional<T> try_pop() noexcept
+		{
+				TSpipeview v = view();
+				std::uint32_t slot;
+				std::optional<T> out;
+				if (!tsPipeViewWriterClaimFront(v, &slot)) return out;
+				T *element = at(slot);
+				out.emplace(std::move(*element));
+				element->~T();
+				tsPipeViewWriterReleaseFront(v, slot);
+				return out;
+		}
+
+		/// Take the oldest element (FIFO). Any thread may call it.
+		std::optional<T> try_steal() noexcept
+		{
+				TSpipeview v = view();
+				std::uint32_t slot;
+				std::optional<T> out;
+				if (!tsPipeViewReaderClaimBack(v, &slot)) return out;
+				T *element = at(slot);
+				out.emplace(std::move(*element));
+				element->~T();
+				tsPipeViewReaderReleaseBack(v, slot);
+				return out;
+		}
+
+private:
+		TSpipeview view() noexcept
+		{
+				TSpipeview v;
+				v.buffer = storage_;
+				v.flags = (unsigned char *)flags_;
+				v.size = sizeof(T);
+				v.stride = sizeof(T);
+				v.flagStride = sizeof(TSpipeflag);
+				v.mask = N - 1;
+				v.writeIndex = &writeIndex_;
+				v.readIndex = &readIndex_;
+				v.readCount = &readCount_;
+				return v;
+		}
+
+		T *at(std::uint32_t slot) noexcept
+		{
+				return std::launder(reinterpret_cast<T *>(storage_ + slot * sizeof(T)));
+		}
+
+		alignas(T) unsigned char storage_[N * sizeof(T)];
+		TSpipeflag volatile flags_[N];
+		std::uint32_t volatile writeIndex_ TS_PIPE_INDEX_ALIGN_;
+		std::uint32_t volatile readIndex_ __attribute__((aligned(4)));
+		std::uint32_t volatile readCount_ TS_PIPE_INDEX_ALIGN_;
+};
+
+} // namespace ts
+
+#endif // PIPE_HPP
@@ -16,6 +16,9 @@
 
 // GCC __atomic_*: https://gcc.gnu.org/onlinedocs/gcc/_005f_005fatomic-Builtins.html.
 
+/// Result of atomic operations which may fail, like compare exchange.
+typedef int TSbool;
+
 /// Memory orders, map to the C++11 memory orders with the same names.
 enum TSmemorder
 {
@@ -66,8 +69,121 @@ static inline int __attribute__((always_inline)) tsAtomicCmpXchg_u32(
 		    ptr, (uint32_t *)expected, (uint32_t *)desired, weak, successOrder, failureOrder);
 }
 
+static inline int __attribute__((always_inline)) tsAtomicCmpXchg_ptr(
+    void *volatile *ptr,
+    void **expected,
+    void **desired,
+    int weak,
+    enum TSmemorder successOrder,
+    enum TSmemorder failureOrder)
+{
+		return __atomic_compare_exchange(ptr, expected, desired, weak, successOrder, failureOrder);
+}
+
 static inline uint32_t __attribute__((always_inline))
 tsAtomicFetchAdd_u32(uint32_t volatile *ptr, uint32_t val, enum TSmemorder memorder)
 {
 		return __atomic_fetch_add(ptr, val, memorder);
 }
+
+static inline void __attribute__((always_inline))
+tsAtomicThreadFence(enum TSmemorder memorder)
+{
+		__atomic_thread_fence(memorder);
+}
+
+static inline void *__attribute__((always_inline))
+tsAtomicLoad_ptr(void *const volatile *dst, enum TSmemorder order)
+{
+		return __atomic_load_n(dst, order);
+}
+
+static inline void __attribute__((always_inline))
+tsAtomicStore_ptr(void *volatile *dst, void *val, enum TSmemorder order)
+{
+		__atomic_store_n(dst, val, order);
+}
+
+static inline uint8_t __attribute__((always_inline))
+tsAtomicLoad_u8(const uint8_t volatile *dst, enum TSmemorder order)
+{
+		return __atomic_load_n(dst, order);
+}
+
+static inline void __attribute__((always_inline))
+tsAtomicStore_u8(uint8_t volatile *dst, uint8_t val, enum TSmemorder order)
+{
+		__atomic_store_n(dst, val, order);
+}
+
+static inline int __attribute__((always_inline)) tsAtomicCmpXchg_u8(
+    uint8_t volatile *ptr,
+    const uint8_t *expected,
+    const uint8_t *desired,
+    int weak,
+    enum TSmemorder successOrder,
+    enum TSmemorder failureOrder)
+{
+		return __atomic_compare_exchange(
+		    ptr, (uint8_t *)expected, (uint8_t *)desired, weak, successOrder, failureOrder);
+}
+
+static inline uint64_t __attribute__((always_inline))
+tsAtomicLoad_u64(const uint64_t volatile *dst, enum TSmemorder order)
+{
+		return __atomic_load_n(dst, order);
+}
+
+static inline void __attribute__((always_inline))
+tsAtomicStore_u64(uint64_t volatile *dst, uint64_t val, enum TSmemorder order)
+{
+		__atomic_store_n(dst, val, order);
+}
+
+static inline int __attribute__((always_inline)) tsAtomicCmpXchg_u64(
+    uint64_t volatile *ptr,
+    const uint64_t *expected,
+    const uint64_t *desired,
+    int weak,
+    enum TSmemorder successOrder,
+    enum TSmemorder failureOrder)
+{
+		return __atomic_compare_exchange(
+		    ptr, (uint64_t *)expected, (uint64_t *)desired, weak, successOrder, failureOrder);
+}
+
+// 16-byte compare exchange, on x86-64 only. GCC turns "__atomic" builtins on "__int128"
+// into calls to libatomic whatever the flags, so it is "lock cmpxchg16b" written out, which
+// needs neither "-mcx16" nor the library. The first CPUs of x86-64 lack the instruction,
+// check "tsAtomicHasCmpXchg_u128" before using it.
+#if defined __x86_64__ && defined __SIZEOF_INT128__
+#		include <cpuid.h>
+
+#		define TS_ATOMIC_CMPXCHG_U128_
+
+/// Whether this CPU has "cmpxchg16b".
+static inline int
+tsAtomicHasCmpXchg_u128(void)
+{
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+		return (ecx & bit_CMPXCHG16B) != 0;
+}
+
+/// Always strong and sequentially consistent. "ptr" must be 16-byte aligned.
+static inline int __attribute__((always_inline)) tsAtomicCmpXchg_u128(
+    unsigned __int128 volatile *ptr,
+    unsigned __int128 *expected,
+    const unsigned __int128 *desired)
+{
+		uint64_t low = (uint64_t)*expected;
+		uint64_t high = (uint64_t)(*expected >> 64);
+		unsigned char success;
+		__asm__ __volatile__("lock cmpxchg16b %1\n\tsete %0"
+		    : "=q"(success), "+m"(*ptr), "+a"(low), "+d"(high)
+		    : "b"((uint64_t)*desired), "c"((uint64_t)(*desired >> 64))
+		    : "memory", "cc");
+		*expected = ((unsigned __int128)high << 64) | low;
+		return success;
+}
+#endif // __x86_64__ && __SIZEOF_INT128__
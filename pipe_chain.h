@@ -0,0 +1,381 @@
+#ifndef PIPE_CHAIN_H
+#define PIPE_CHAIN_H
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Growable pipe -------------------------------------------------------------------------
+//
+// A chain of fixed-size pipe blocks, oldest first. When the writer's block ("tail") is
+// full it links another one behind it instead of failing, so the writer never has to wait
+// for readers. Readers start at the oldest block ("head") and drain blocks in order while
+// the writer fills the youngest one.
+//
+// Whoever finds the head block drained (empty and no longer the writer's) unlinks it by
+// moving "head" on. Readers that loaded "head" earlier may still be in an unlinked block,
+// so the writer reuses or frees it only once they are gone, which it learns from epochs:
+// readers count themselves in "readers" of the current "epoch" for as long as they hold a
+// block, and the writer moves "epoch" on once nobody of the epoch before is left. A block
+// found unlinked in epoch "e" is out of every reader's hands in epoch "e + 2". Blocks thus
+// never change under a reader, which sees them in order and always reaches "tail".
+//
+// Past "TS_CHAIN_SPARE_BLOCKS" unlinked blocks kept for growth, the writer frees them
+// whenever it links a block or calls "tsChainReclaim", so memory follows the backlog down
+// after a burst instead of staying at its peak.
+
+#ifndef TS_CHAIN_SPARE_BLOCKS
+/// Unlinked blocks the writer keeps around for growth, more are freed.
+#		define TS_CHAIN_SPARE_BLOCKS 4
+#endif // TS_CHAIN_SPARE_BLOCKS
+
+/// Header of a block, followed by "mask + 1" flags and as many elements.
+struct TSchainblock
+{
+		/// Next younger block, NULL for "tail".
+		struct TSchainblock *volatile next;
+
+		/// Epoch in which the writer found the block unlinked, used only by the writer.
+		uint32_t epoch;
+
+		/// See "TS_PIPE_DEFINE".
+		uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_;
+		uint32_t volatile readIndex __attribute__((aligned(4)));
+		uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_;
+};
+
+typedef struct TSchainblock TSchainblock;
+
+/// Untyped chain, see "TS_CHAINPIPE_DEFINE" for the typed one. Elements are at most 16
+/// bytes aligned.
+struct TSchain
+{
+		/// Oldest linked block, readers start here.
+		TSchainblock *volatile head;
+
+		/// Youngest block, used only by the writer.
+		TSchainblock *tail;
+
+		/// Oldest block of all, used only by the writer. Following "next" from here, the blocks
+		/// before "head" are unlinked, the ones before "unstamped" have their "epoch" set.
+		TSchainblock *retired;
+		TSchainblock *unstamped;
+
+		/// Number of elements per block minus one.
+		uint32_t mask;
+
+		/// Moved on only by the writer.
+		uint32_t volatile epoch TS_PIPE_INDEX_ALIGN_;
+
+		/// Readers holding a block, by the parity of the epoch they entered in.
+		uint32_t volatile readers[2] TS_PIPE_INDEX_ALIGN_;
+};
+
+typedef struct TSchain TSchain;
+
+static inline size_t __attribute__((always_inline))
+tsChainBufferOffset(uint32_t mask)
+{
+		size_t offset = sizeof(TSchainblock) + ((size_t)mask + 1) * sizeof(TSpipeflag);
+		return (offset + 15) & ~(size_t)15;
+}
+
+static inline TSpipeview __attribute__((always_inline))
+tsChainBlockView(TSchain *chain, TSchainblock *block, size_t size)
+{
+		TSpipeview view;
+		view.buffer = (unsigned char *)block + tsChainBufferOffset(chain->mask);
+		view.flags = (unsigned char *)(block + 1);
+		view.size = size;
+		view.stride = size;
+		view.flagStride = sizeof(TSpipeflag);
+		view.mask = chain->mask;
+		view.writeIndex = &block->writeIndex;
+		view.readIndex = &block->readIndex;
+		view.readCount = &block->readCount;
+		return view;
+}
+
+static inline TSchainblock *__attribute__((always_inline))
+tsChainLoadHead(TSchain *chain, enum TSmemorder order)
+{
+		return (TSchainblock *)tsAtomicLoad_ptr((void *const volatile *)&chain->head, order);
+}
+
+static inline TSchainblock *__attribute__((always_inline))
+tsChainLoadNext(TSchainblock *block)
+{
+		return (TSchainblock *)tsAtomicLoad_ptr((void *const volatile *)&block->next, TS_ACQUIRE);
+}
+
+/// Count a reader in the current epoch before it loads "head", return the epoch to pass to
+/// "tsChainLeave" once it holds no block any more.
+static inline uint32_t __attribute__((always_inline))
+tsChainEnter(TSchain *chain)
+{
+		while (1)
+		{
+				// Either the writer sees us counted, or we see it moved on and count again.
+				uint32_t epoch = tsAtomicLoad_u32(&chain->epoch, TS_RELAXED);
+				tsAtomicFetchAdd_u32(&chain->readers[epoch & 1], 1, TS_SEQ_CST);
+				if (tsAtomicLoad_u32(&chain->epoch, TS_SEQ_CST) == epoch) return epoch;
+				tsAtomicFetchAdd_u32(&chain->readers[epoch & 1], (uint32_t)-1, TS_RELAXED);
+		}
+}
+
+static inline void __attribute__((always_inline))
+tsChainLeave(TSchain *chain, uint32_t epoch)
+{
+		tsAtomicFetchAdd_u32(&chain->readers[epoch & 1], (uint32_t)-1, TS_RELEASE);
+}
+
+/// Whether the unlinked "block" is out of every reader's hands. Used only by the writer.
+static inline int __attribute__((always_inline))
+tsChainIsSafe(TSchain *chain, TSchainblock *block)
+{
+		return block != chain->unstamped && chain->epoch - block->epoch >= 2;
+}
+
+/// Allocate an empty block, return NULL if the allocation failed.
+static inline TSchainblock *
+tsChainNewBlock(TSchain *chain, size_t size)
+{
+		size_t align = __alignof__(TSchainblock);
+		size_t bytes = tsChainBufferOffset(chain->mask) + ((size_t)chain->mask + 1) * size;
+		bytes = (bytes + align - 1) & ~(align - 1);
+
+		TSchainblock *block = (TSchainblock *)aligned_alloc(align, bytes);
+		if (!block) return NULL;
+
+		memset((void *)(block + 1), 0, ((size_t)chain->mask + 1) * sizeof(TSpipeflag));
+		block->next = NULL;
+		block->epoch = 0;
+		block->writeIndex = 0;
+		block->readIndex = 0;
+		block->readCount = 0;
+		return block;
+}
+
+/// Initialize a chain of blocks of "1 << blockSizeLog2" elements of "size" bytes.
+/// Return 0 if the allocation failed.
+static inline int
+tsChainInit(TSchain *chain, uint32_t blockSizeLog2, size_t size)
+{
+		if (blockSizeLog2 >= 32) return 0;
+		chain->mask = (uint32_t)(((size_t)1 << blockSizeLog2) - 1);
+		chain->epoch = 0;
+		chain->readers[0] = 0;
+		chain->readers[1] = 0;
+		chain->tail = tsChainNewBlock(chain, size);
+		chain->head = chain->tail;
+		chain->retired = chain->tail;
+		chain->unstamped = chain->tail;
+		return chain->tail != NULL;
+}
+
+/// Free every block, no other thread may use the chain any more.
+static inline void
+tsChainDestroy(TSchain *chain)
+{
+		TSchainblock *block = chain->retired;
+		while (block)
+		{
+				TSchainblock *next = block->next;
+				free(block);
+				block = next;
+		}
+		chain->head = NULL;
+		chain->tail = NULL;
+		chain->retired = NULL;
+		chain->unstamped = NULL;
+}
+
+/// Unlink "block" if it is still the head and drained: empty and with a younger block
+/// behind it, so that the writer will never write to it again. The caller must hold
+/// "block", as a reader or as the writer.
+static inline void
+tsChainTrim(TSchain *chain, TSchainblock *block, size_t size)
+{
+		TSchainblock *next = tsChainLoadNext(block);
+		if (next && tsPipeViewIsEmpty(tsChainBlockView(chain, block, size)))
+		{
+				void *expected = block;
+				void *desired = next;
+				tsAtomicCmpXchg_ptr(
+				    (void *volatile *)&chain->head, &expected, &desired, 0, TS_ACQ_REL, TS_RELAXED);
+		}
+}
+
+/// Not intended for general use. Should only be used very prudently.
+static inline int
+tsChainIsEmpty(TSchain *chain, size_t size)
+{
+		uint32_t epoch = tsChainEnter(chain);
+		TSchainblock *block = tsChainLoadHead(chain, TS_ACQUIRE);
+		for (; block; block = tsChainLoadNext(block))
+		{
+				if (!tsPipeViewIsEmpty(tsChainBlockView(chain, block, size))) break;
+		}
+		tsChainLeave(chain, epoch);
+		return block == NULL;
+}
+
+/// Return 0 if we were unable to read.
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsChainReaderTryReadBack(TSchain *chain, void *out, size_t size)
+{
+		uint32_t epoch = tsChainEnter(chain);
+		TSchainblock *block = tsChainLoadHead(chain, TS_ACQUIRE);
+		int read = tsPipeViewReaderTryReadBack(tsChainBlockView(chain, block, size), out);
+		if (!read)
+		{
+				// The oldest block has nothing left, unlink it if it is drained. It cannot have
+				// been reused since we loaded it, so it is still the head unless unlinked already.
+				tsChainTrim(chain, block, size);
+				for (block = tsChainLoadNext(block); block && !read; block = tsChainLoadNext(block))
+				{
+						read = tsPipeViewReaderTryReadBack(tsChainBlockView(chain, block, size), out);
+				}
+		}
+		tsChainLeave(chain, epoch);
+		return read;
+}
+
+/// Read the newest element of the youngest block. Once that block is empty, fall back to
+/// the oldest element of the chain, as older blocks can only be read from the back.
+/// Return 0 if we were unable to read.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsChainWriterTryReadFront(TSchain *chain, void *out, size_t size)
+{
+		TSpipeview view = tsChainBlockView(chain, chain->tail, size);
+		if (tsPipeViewWriterTryReadFront(view, out)) return 1;
+		if (tsChainLoadHead(chain, TS_RELAXED) == chain->tail) return 0;
+		return tsChainReaderTryReadBack(chain, out, size);
+}
+
+/// Move the epoch on as far as readers allow, then free the unlinked blocks no reader can
+/// hold any more, but for "TS_CHAIN_SPARE_BLOCKS" of them kept for growth.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline void
+tsChainReclaim(TSchain *chain, size_t size)
+{
+		// We are the only one reusing blocks, so we hold every block and may trim.
+		tsChainTrim(chain, tsChainLoadHead(chain, TS_ACQUIRE), size);
+
+		// Readers still in a block unlinked by now entered in this epoch at the latest.
+		TSchainblock *head = tsChainLoadHead(chain, TS_ACQUIRE);
+		uint32_t epoch = chain->epoch;
+		for (; chain->unstamped != head; chain->unstamped = chain->unstamped->next)
+		{
+				chain->unstamped->epoch = epoch;
+		}
+
+		// Twice at most, as the readers of the epoch we leave are usually still about.
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+				if (tsAtomicLoad_u32(&chain->readers[(epoch + 1) & 1], TS_SEQ_CST) != 0) break;
+				tsAtomicStore_u32(&chain->epoch, ++epoch, TS_SEQ_CST);
+		}
+
+		uint32_t spares = 0;
+		TSchainblock *block = chain->retired;
+		for (; tsChainIsSafe(chain, block); block = block->next) ++spares;
+		for (; spares > TS_CHAIN_SPARE_BLOCKS; --spares)
+		{
+				block = chain->retired;
+				chain->retired = block->next;
+				free(block);
+		}
+}
+
+/// Link a block behind "tail" and return it: an unlinked one if no reader holds it any
+/// more, a new one otherwise. Return NULL if the allocation failed.
+static inline TSchainblock *
+tsChainGrow(TSchain *chain, size_t size)
+{
+		tsChainReclaim(chain, size);
+
+		TSchainblock *block = chain->retired;
+		if (tsChainIsSafe(chain, block))
+		{
+				chain->retired = block->next;
+				tsAtomicStore_ptr((void *volatile *)&block->next, NULL, TS_RELAXED);
+		}
+		else
+		{
+				block = tsChainNewBlock(chain, size);
+				if (!block) return NULL;
+		}
+
+		// Publish the block only once it is ready, readers may follow "next" right away.
+		tsAtomicStore_ptr((void *volatile *)&chain->tail->next, block, TS_RELEASE);
+		chain->tail = block;
+		return block;
+}
+
+/// Write to the youngest block, linking another one when it is full. Return 0 only if a
+/// new block was needed and could not be allocated.
+/// This is thread safe for the single writer, but should not be called by readers
+static inline int __attribute__((always_inline))
+tsChainWriterTryWriteFront(TSchain *chain, const void *in, size_t size)
+{
+		TSpipeview view = tsChainBlockView(chain, chain->tail, size);
+		if (tsPipeViewWriterTryWriteFront(view, in)) return 1;
+
+		TSchainblock *block = tsChainGrow(chain, size);
+		if (!block) return 0;
+		return tsPipeViewWriterTryWriteFront(tsChainBlockView(chain, block, size), in);
+}
+
+/// Define growable pipe "Name" of "type" elements, with "prefix##Init(pipe, blockSizeLog2)"
+/// (returning 0 if the allocation failed), "prefix##Destroy", "prefix##IsEmpty",
+/// "prefix##ReaderTryReadBack", "prefix##WriterTryReadFront", "prefix##WriterTryWriteFront"
+/// and "prefix##WriterReclaim".
+#define TS_CHAINPIPE_DEFINE(Name, prefix, type) \
+		TS_STATIC_ASSERT(__alignof__(type) <= 16, #Name ": type must be at most 16 aligned"); \
+		struct Name \
+		{ \
+				TSchain chain; \
+		}; \
+		typedef struct Name Name; \
+		static inline int prefix##Init(Name *pipe, uint32_t blockSizeLog2) \
+		{ \
+				return tsChainInit(&pipe->chain, blockSizeLog2, sizeof(type)); \
+		} \
+		static inline void prefix##Destroy(Name *pipe) \
+		{ \
+				tsChainDestroy(&pipe->chain); \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsChainIsEmpty(&pipe->chain, sizeof(type)); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, type *out) \
+		{ \
+				return tsChainReaderTryReadBack(&pipe->chain, out, sizeof(type)); \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, type *out) \
+		{ \
+				return tsChainWriterTryReadFront(&pipe->chain, out, sizeof(type)); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, type *in) \
+		{ \
+				return tsChainWriterTryWriteFront(&pipe->chain, in, sizeof(type)); \
+		} \
+		static inline void prefix##WriterReclaim(Name *pipe) \
+		{ \
+				tsChainReclaim(&pipe->chain, sizeof(type)); \
+		}
+
+/// The default growable pipe, elements of "TSpipedata".
+TS_CHAINPIPE_DEFINE(TSchainpipe, tsChainPipe, TSpipedata)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_CHAIN_H
@@ -0,0 +1,168 @@
+#ifndef PIPE_MPMC_H
+#define PIPE_MPMC_H
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Multi-producer multi-consumer queue ----------------------------------------------------
+//
+// A bounded FIFO any number of threads may enqueue to and dequeue from, lock-free. Where a
+// pipe has a single writer owning "writeIndex", producers here claim a slot by moving
+// "enqueueIndex" on with a compare exchange, and consumers do the same with "dequeueIndex".
+//
+// Instead of a flag, every slot holds a sequence number telling whose turn it is: the
+// slot of position "i" is free for the producer of "i" while its sequence is "i", holds the
+// element of "i" for its consumer once it is "i + 1", and is handed to the producer of
+// "i + size" by setting it to "i + size". A claimed slot therefore belongs to one thread
+// only until it moves the sequence on, and elements of later laps wait for it.
+
+/// Where a queue keeps its data, see "TSpipeview".
+struct TSmpmcview
+{
+		unsigned char *buffer;
+		uint32_t volatile *sequences;
+		size_t size;
+		uint32_t mask;
+		uint32_t volatile *enqueueIndex;
+		uint32_t volatile *dequeueIndex;
+};
+
+typedef struct TSmpmcview TSmpmcview;
+
+static inline void
+tsMpmcViewInit(TSmpmcview view)
+{
+		for (uint32_t i = 0; i <= view.mask; ++i) view.sequences[i] = i;
+		*view.enqueueIndex = 0;
+		*view.dequeueIndex = 0;
+}
+
+/// Not intended for general use, the answer may be stale by the time it is returned.
+static inline int __attribute__((always_inline))
+tsMpmcViewIsEmpty(TSmpmcview view)
+{
+		return tsAtomicLoad_u32(view.enqueueIndex, TS_RELAXED) ==
+		    tsAtomicLoad_u32(view.dequeueIndex, TS_RELAXED);
+}
+
+/// Return 0 if the queue is full. Thread safe.
+static inline int __attribute__((always_inline))
+tsMpmcViewTryEnqueue(TSmpmcview view, const void *in)
+{
+		uint32_t position = tsAtomicLoad_u32(view.enqueueIndex, TS_RELAXED);
+		uint32_t volatile *sequence;
+		while (1)
+		{
+				sequence = &view.sequences[position & view.mask];
+				int32_t lap = (int32_t)(tsAtomicLoad_u32(sequence, TS_ACQUIRE) - position);
+				if (lap == 0)
+				{
+						// On failure "position" is updated to the index another producer left behind.
+						uint32_t desired = position + 1;
+						if (tsAtomicCmpXchg_u32(view.enqueueIndex, &position, &desired, 1, TS_RELAXED,
+								    TS_RELAXED))
+						{
+								break;
+						}
+				}
+				else if (lap < 0)
+				{
+						// The consumer of the previous lap has not taken its element yet.
+						TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+						return 0;
+				}
+				else { position = tsAtomicLoad_u32(view.enqueueIndex, TS_RELAXED); }
+		}
+
+		memcpy(view.buffer + (size_t)(position & view.mask) * view.size, in, view.size);
+		tsAtomicStore_u32(sequence, position + 1, TS_RELEASE);
+		TS_TRACE_EVENT_(TS_TRACE_PUSH, 1);
+		return 1;
+}
+
+/// Return 0 if the queue is empty. Thread safe.
+static inline int __attribute__((always_inline))
+tsMpmcViewTryDequeue(TSmpmcview view, void *out)
+{
+		uint32_t position = tsAtomicLoad_u32(view.dequeueIndex, TS_RELAXED);
+		uint32_t volatile *sequence;
+		while (1)
+		{
+				sequence = &view.sequences[position & view.mask];
+				int32_t lap = (int32_t)(tsAtomicLoad_u32(sequence, TS_ACQUIRE) - (position + 1));
+				if (lap == 0)
+				{
+						uint32_t desired = position + 1;
+						if (tsAtomicCmpXchg_u32(view.dequeueIndex, &position, &desired, 1, TS_RELAXED,
+								    TS_RELAXED))
+						{
+								break;
+						}
+				}
+				else if (lap < 0)
+				{
+						// Nothing was enqueued here yet, or its producer has not finished writing it.
+						TS_TRACE_EVENT_(TS_TRACE_STEAL_EMPTY, 0);
+						return 0;
+				}
+				else { position = tsAtomicLoad_u32(view.dequeueIndex, TS_RELAXED); }
+		}
+
+		memcpy(out, view.buffer + (size_t)(position & view.mask) * view.size, view.size);
+		tsAtomicStore_u32(sequence, position + view.mask + 1, TS_RELEASE);
+		TS_TRACE_EVENT_(TS_TRACE_STEAL, 1);
+		return 1;
+}
+
+/// Define a queue type "Name" of "1 << log2size" elements of "type", and functions
+/// "prefix##Init", "prefix##IsEmpty", "prefix##TryEnqueue" and "prefix##TryDequeue". The
+/// indices get a cache line each, all producers and all consumers fight over them.
+#define TS_MPMC_QUEUE_DEFINE(Name, prefix, type, log2size) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name \
+		{ \
+				type buffer[(size_t)1 << (log2size)]; \
+				uint32_t volatile sequences[(size_t)1 << (log2size)]; \
+				uint32_t volatile enqueueIndex __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+				uint32_t volatile dequeueIndex __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+		} __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+		typedef struct Name Name; \
+		static inline TSmpmcview __attribute__((always_inline)) prefix##View(Name *queue) \
+		{ \
+				TSmpmcview view; \
+				view.buffer = (unsigned char *)queue->buffer; \
+				view.sequences = queue->sequences; \
+				view.size = sizeof(type); \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.enqueueIndex = &queue->enqueueIndex; \
+				view.dequeueIndex = &queue->dequeueIndex; \
+				return view; \
+		} \
+		static inline void prefix##Init(Name *queue) \
+		{ \
+				tsMpmcViewInit(prefix##View(queue)); \
+		} \
+		static inline int prefix##IsEmpty(Name *queue) \
+		{ \
+				return tsMpmcViewIsEmpty(prefix##View(queue)); \
+		} \
+		static inline int prefix##TryEnqueue(Name *queue, type *in) \
+		{ \
+				return tsMpmcViewTryEnqueue(prefix##View(queue), in); \
+		} \
+		static inline int prefix##TryDequeue(Name *queue, type *out) \
+		{ \
+				return tsMpmcViewTryDequeue(prefix##View(queue), out); \
+		}
+
+/// The default queue, as many elements of "TSpipedata" as "TSpipe".
+TS_MPMC_QUEUE_DEFINE(TSmpmcqueue, tsMpmcQueue, TSpipedata, TS_PIPE_SIZE_LOG2)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_MPMC_H
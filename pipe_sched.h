@@ -0,0 +1,454 @@
+#ifndef PIPE_SCHED_H
+#define PIPE_SCHED_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "./pipe.h"
+#include "./pipe_wait.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Task scheduler -------------------------------------------------------------------------
+//
+// A pool of worker threads, each the single writer of its own pipe of tasks. A worker
+// pushes the tasks it spawns to the front of its pipe and pops them back LIFO, so it keeps
+// working on the data it touched last. Once its pipe is empty it steals FIFO from the back
+// of another worker's pipe, where the oldest and usually biggest pieces of work are.
+//
+// Threads outside the pool may not write to a worker's pipe, they submit to a shared pipe
+// whose writer side is serialized by a mutex. Workers steal from it like from any other.
+//
+// A worker that finds no task for a while sleeps on the pool's event count, every spawned
+// task wakes one sleeping worker. An idle pool costs no CPU.
+
+#ifndef TS_SCHED_PIPE_SIZE_LOG2
+/// Capacity of every worker's pipe, a task spawned into a full pipe runs right away.
+#		define TS_SCHED_PIPE_SIZE_LOG2 10
+#endif // TS_SCHED_PIPE_SIZE_LOG2
+
+#ifndef TS_SCHED_FOR_GRAIN
+/// Iterations "tsSchedulerParallelFor" runs between two looks at whether to split.
+#		define TS_SCHED_FOR_GRAIN 64
+#endif // TS_SCHED_FOR_GRAIN
+
+#ifndef TS_SCHED_SPIN_COUNT
+/// Failed attempts to find a task before an idle worker sleeps, or a thread waiting for
+/// tasks starts yielding its core.
+#		define TS_SCHED_SPIN_COUNT 64
+#endif // TS_SCHED_SPIN_COUNT
+
+/// Number of unfinished tasks spawned with it, zero it before use.
+struct TScounter
+{
+		uint32_t volatile count;
+};
+
+typedef struct TScounter TScounter;
+
+struct TStask
+{
+		void (*func)(void *arg);
+		void *arg;
+
+		/// Decremented once "func" returned, may be NULL.
+		TScounter *counter;
+};
+
+typedef struct TStask TStask;
+
+TS_PIPE_DEFINE(TSschedpipe, tsSchedPipe, TStask, TS_SCHED_PIPE_SIZE_LOG2)
+
+struct TSscheduler;
+
+struct TSschedworker
+{
+		TSschedpipe pipe;
+		struct TSscheduler *scheduler;
+		pthread_t thread;
+		uint32_t index;
+
+		/// State of the generator picking the first victim to steal from.
+		uint32_t seed;
+
+		/// "readCount" of "pipe" when "tsSchedulerParallelFor" last looked, it only moves when
+		/// a thief took a task.
+		uint32_t seenReadCount;
+};
+
+typedef struct TSschedworker TSschedworker;
+
+struct TSscheduler
+{
+		TSschedworker *workers;
+		uint32_t numWorkers;
+
+		/// Tasks submitted by threads outside the pool.
+		TSschedpipe *external;
+		pthread_mutex_t externalLock;
+
+		/// Worker of the calling thread, NULL outside the pool.
+		pthread_key_t workerKey;
+
+		/// Idle workers sleep on it until a task is spawned or "stop" is raised.
+		TSeventcount idle;
+
+		uint32_t volatile stop;
+};
+
+typedef struct TSscheduler TSscheduler;
+
+/// Number of cores available, at least 1.
+static inline uint32_t
+tsSchedNumCores(void)
+{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		return cores > 0 ? (uint32_t)cores : 1;
+}
+
+/// Idle moment of a thread waiting on a counter: pause for the first "TS_SCHED_SPIN_COUNT"
+/// calls, yield the core after. It cannot sleep, nothing wakes it when the counter drops.
+static inline void
+tsSchedIdle(uint32_t *spins)
+{
+		if (*spins < TS_SCHED_SPIN_COUNT)
+		{
+				++*spins;
+				tsWaitPause();
+		}
+		else sched_yield();
+}
+
+static inline void
+tsSchedRun(TStask *task)
+{
+		TS_TRACE_EVENT_(TS_TRACE_TASK_BEGIN, 0);
+		task->func(task->arg);
+		TS_TRACE_EVENT_(TS_TRACE_TASK_END, 0);
+		if (task->counter) tsAtomicFetchAdd_u32(&task->counter->count, (uint32_t)-1, TS_RELEASE);
+}
+
+/// Steal the oldest task of another worker or, failing that, of the external pipe.
+/// "worker" is NULL for threads outside the pool. Return 0 if there was nothing to steal.
+static inline int
+tsSchedSteal(TSscheduler *sched, TSschedworker *worker, TStask *out)
+{
+		uint32_t first = 0;
+		if (worker)
+		{
+				// xorshift, so that thieves spread over the victims instead of piling on one.
+				uint32_t seed = worker->seed;
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				worker->seed = seed;
+				first = seed % sched->numWorkers;
+		}
+
+		for (uint32_t i = 0; i < sched->numWorkers; ++i)
+		{
+				TSschedworker *victim = &sched->workers[(first + i) % sched->numWorkers];
+				if (victim == worker) continue;
+				if (tsSchedPipeReaderTryReadBack(&victim->pipe, out)) return 1;
+		}
+		return tsSchedPipeReaderTryReadBack(sched->external, out);
+}
+
+/// Take the newest task of our own pipe, or steal one. Return 0 if there was none.
+static inline int
+tsSchedFind(TSscheduler *sched, TSschedworker *worker, TStask *out)
+{
+		return (worker && tsSchedPipeWriterTryReadFront(&worker->pipe, out)) ||
+		    tsSchedSteal(sched, worker, out);
+}
+
+/// Run one task: the newest of our own pipe, or a stolen one. Return 0 if there was none.
+static inline int
+tsSchedRunOne(TSscheduler *sched, TSschedworker *worker)
+{
+		TStask task;
+		if (!tsSchedFind(sched, worker, &task)) return 0;
+		tsSchedRun(&task);
+		return 1;
+}
+
+/// Sleep until a task was spawned or "stop" raised, unless there is a task already, which
+/// we run instead.
+static inline void
+tsSchedPark(TSscheduler *sched, TSschedworker *worker)
+{
+		TStask task;
+		uint32_t key = tsEventCountPrepareWait(&sched->idle);
+
+		// Spawners see us from now on, so what they publish after this look wakes us.
+		if (tsAtomicLoad_u32(&sched->stop, TS_ACQUIRE))
+		{
+				tsEventCountCancelWait(&sched->idle);
+				return;
+		}
+		if (tsSchedFind(sched, worker, &task))
+		{
+				tsEventCountCancelWait(&sched->idle);
+				tsSchedRun(&task);
+				return;
+		}
+		TS_TRACE_EVENT_(TS_TRACE_PARK, 0);
+		tsEventCountWait(&sched->idle, key, TS_WAIT_FOREVER);
+		TS_TRACE_EVENT_(TS_TRACE_UNPARK, 0);
+}
+
+static inline void *
+tsSchedWorkerMain(void *arg)
+{
+		TSschedworker *worker = (TSschedworker *)arg;
+		TSscheduler *sched = worker->scheduler;
+		pthread_setspecific(sched->workerKey, worker);
+
+		uint32_t spins = 0;
+		while (1)
+		{
+				// Look at "stop" before looking for work, so that we only leave once an attempt
+				// that sees every task spawned before "stop" was raised came up empty. Tasks may
+				// still spawn tasks, nothing must be left anywhere.
+				uint32_t stop = tsAtomicLoad_u32(&sched->stop, TS_ACQUIRE);
+				if (tsSchedRunOne(sched, worker))
+				{
+						spins = 0;
+						continue;
+				}
+				if (stop) break;
+				if (spins < TS_SCHED_SPIN_COUNT)
+				{
+						++spins;
+						tsWaitPause();
+						continue;
+				}
+				tsSchedPark(sched, worker);
+				spins = 0;
+		}
+		return NULL;
+}
+
+static inline void
+tsSchedFree(TSscheduler *sched)
+{
+		free(sched->workers);
+		free(sched->external);
+		sched->workers = NULL;
+		sched->external = NULL;
+}
+
+/// Start "numWorkers" worker threads, one per core if 0. Return 0 if we failed.
+static inline int
+tsSchedulerInit(TSscheduler *sched, uint32_t numWorkers)
+{
+		if (numWorkers == 0) numWorkers = tsSchedNumCores();
+
+		sched->numWorkers = numWorkers;
+		sched->stop = 0;
+		sched->workers = (TSschedworker *)aligned_alloc(
+		    __alignof__(TSschedworker), numWorkers * sizeof(TSschedworker));
+		sched->external =
+		    (TSschedpipe *)aligned_alloc(__alignof__(TSschedpipe), sizeof(TSschedpipe));
+		if (!sched->workers || !sched->external || pthread_key_create(&sched->workerKey, NULL))
+		{
+				tsSchedFree(sched);
+				return 0;
+		}
+		pthread_mutex_init(&sched->externalLock, NULL);
+		tsEventCountInit(&sched->idle);
+		tsSchedPipeInit(sched->external);
+
+		for (uint32_t i = 0; i < numWorkers; ++i)
+		{
+				TSschedworker *worker = &sched->workers[i];
+				tsSchedPipeInit(&worker->pipe);
+				worker->scheduler = sched;
+				worker->index = i;
+				worker->seed = 0x9E3779B9u * (i + 1);
+				worker->seenReadCount = 0;
+		}
+
+		for (uint32_t i = 0; i < numWorkers; ++i)
+		{
+				TSschedworker *worker = &sched->workers[i];
+				if (pthread_create(&worker->thread, NULL, tsSchedWorkerMain, worker) != 0)
+				{
+						// Nothing was spawned yet, the workers started so far leave right away.
+						tsAtomicStore_u32(&sched->stop, 1, TS_RELEASE);
+						tsEventCountNotifyAll(&sched->idle);
+						while (i) pthread_join(sched->workers[--i].thread, NULL);
+						tsEventCountDestroy(&sched->idle);
+						pthread_mutex_destroy(&sched->externalLock);
+						pthread_key_delete(sched->workerKey);
+						tsSchedFree(sched);
+						return 0;
+				}
+		}
+		return 1;
+}
+
+/// Let the workers finish every task left, including those spawned meanwhile, and join
+/// them. No thread outside the pool may spawn any more.
+static inline void
+tsSchedulerDestroy(TSscheduler *sched)
+{
+		tsAtomicStore_u32(&sched->stop, 1, TS_RELEASE);
+		tsEventCountNotifyAll(&sched->idle);
+		for (uint32_t i = 0; i < sched->numWorkers; ++i)
+		{
+				pthread_join(sched->workers[i].thread, NULL);
+		}
+
+		tsEventCountDestroy(&sched->idle);
+		pthread_mutex_destroy(&sched->externalLock);
+		pthread_key_delete(sched->workerKey);
+		tsSchedFree(sched);
+}
+
+/// Worker of the calling thread, NULL if it is not one of "sched".
+static inline TSschedworker *
+tsSchedulerCurrentWorker(TSscheduler *sched)
+{
+		return (TSschedworker *)pthread_getspecific(sched->workerKey);
+}
+
+/// Run "func(arg)" on some thread of the pool and decrement "counter" (if not NULL) once
+/// it returned. If there is no room for the task, it runs right away on the calling thread.
+/// Any thread may call it.
+static inline void
+tsSchedulerSpawn(TSscheduler *sched, void (*func)(void *), void *arg, TScounter *counter)
+{
+		TStask task;
+		task.func = func;
+		task.arg = arg;
+		task.counter = counter;
+		if (counter) tsAtomicFetchAdd_u32(&counter->count, 1, TS_RELAXED);
+
+		int written;
+		TSschedworker *worker = tsSchedulerCurrentWorker(sched);
+		if (worker) { written = tsSchedPipeWriterTryWriteFront(&worker->pipe, &task); }
+		else
+		{
+				pthread_mutex_lock(&sched->externalLock);
+				written = tsSchedPipeWriterTryWriteFront(sched->external, &task);
+				pthread_mutex_unlock(&sched->externalLock);
+		}
+		if (written) tsEventCountNotifyOne(&sched->idle);
+		else tsSchedRun(&task);
+}
+
+/// Return once every task spawned with "counter" has finished, running other tasks in the
+/// meantime. Any thread may call it.
+static inline void
+tsSchedulerWait(TSscheduler *sched, TScounter *counter)
+{
+		TSschedworker *worker = tsSchedulerCurrentWorker(sched);
+		uint32_t spins = 0;
+		while (tsAtomicLoad_u32(&counter->count, TS_ACQUIRE) != 0)
+		{
+				if (tsSchedRunOne(sched, worker)) spins = 0;
+				else tsSchedIdle(&spins);
+		}
+}
+
+struct TSschedfor
+{
+		TSscheduler *sched;
+		void (*body)(void *ctx, uint64_t begin, uint64_t end);
+		void *ctx;
+};
+
+struct TSschedrange
+{
+		const struct TSschedfor *loop;
+		uint64_t begin;
+		uint64_t end;
+};
+
+/// Whether a running range should give half of what is left away: nobody would find work
+/// in our pipe, or a thief just took some, so others are hungry. Outside the pool "our"
+/// pipe is the one shared by external threads.
+static inline int
+tsSchedForWantsSplit(TSscheduler *sched, TSschedworker *worker)
+{
+		if (!worker) return tsSchedPipeIsEmpty(sched->external);
+
+		uint32_t readCount = tsAtomicLoad_u32(&worker->pipe.readCount, TS_RELAXED);
+		int stolen = readCount != worker->seenReadCount;
+		worker->seenReadCount = readCount;
+		return stolen || tsSchedPipeIsEmpty(&worker->pipe);
+}
+
+static inline void tsSchedForTask(void *arg);
+
+/// Run "body" over [begin, end) in steps of "TS_SCHED_FOR_GRAIN" (lazy binary splitting).
+/// Before every step the range may split in two, the upper half is spawned and the lower
+/// one continues one call deeper, so every split keeps its half alive on our stack until
+/// it is done.
+static inline void
+tsSchedForRun(const struct TSschedfor *loop, uint64_t begin, uint64_t end)
+{
+		TSschedworker *worker = tsSchedulerCurrentWorker(loop->sched);
+		while (begin < end)
+		{
+				if (end - begin > TS_SCHED_FOR_GRAIN && tsSchedForWantsSplit(loop->sched, worker))
+				{
+						TScounter counter = {0};
+						struct TSschedrange upper;
+						upper.loop = loop;
+						upper.begin = begin + (end - begin) / 2;
+						upper.end = end;
+						tsSchedulerSpawn(loop->sched, tsSchedForTask, &upper, &counter);
+						tsSchedForRun(loop, begin, upper.begin);
+						tsSchedulerWait(loop->sched, &counter);
+						return;
+				}
+
+				uint64_t step = end - begin < TS_SCHED_FOR_GRAIN ? end - begin : TS_SCHED_FOR_GRAIN;
+				loop->body(loop->ctx, begin, begin + step);
+				begin += step;
+		}
+}
+
+static inline void
+tsSchedForTask(void *arg)
+{
+		struct TSschedrange *range = (struct TSschedrange *)arg;
+		tsSchedForRun(range->loop, range->begin, range->end);
+}
+
+/// Call "body(ctx, b, e)" for consecutive sub-ranges [b, e) covering [begin, end), spread
+/// over the pool, and return once all are done. Ranges are only split when other workers
+/// run out of work, so there is no chunk size to tune. Any thread may call it.
+static inline void
+tsSchedulerParallelFor(TSscheduler *sched,
+    uint64_t begin,
+    uint64_t end,
+    void (*body)(void *ctx, uint64_t begin, uint64_t end),
+    void *ctx)
+{
+		struct TSschedfor loop;
+		loop.sched = sched;
+		loop.body = body;
+		loop.ctx = ctx;
+
+		struct TSschedrange range;
+		range.loop = &loop;
+		range.begin = begin;
+		range.end = end;
+
+		// Go through a task, so that a thread outside the pool hands the loop to the workers.
+		TScounter counter = {0};
+		tsSchedulerSpawn(sched, tsSchedForTask, &range, &counter);
+		tsSchedulerWait(sched, &counter);
+}
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_SCHED_H
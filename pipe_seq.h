@@ -0,0 +1,224 @@
+#ifndef PIPE_SEQ_H
+#define PIPE_SEQ_H
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Sequence-numbered pipe -----------------------------------------------------------------
+//
+// Drop-in alternative to "TSpipe" with the same writer-front / reader-back semantics, but
+// instead of the "TS_PIPE_*" flags every slot carries a sequence number telling which
+// position it serves (as in Dmitry Vyukov's bounded queue):
+// - "seq == position", the slot is free for the element at "position".
+// - "seq == position + 1", the slot holds the element at "position".
+//
+// Readers claim the oldest element with a compare exchange on "readIndex" itself (the top
+// of a Chase-Lev deque), so they go straight to the next claimable slot rather than
+// probing flags one by one. The writer pops its newest element by moving "writeIndex" back
+// and only races the readers for the very last one. Sequence numbers tell laps apart, so a
+// stale slot or a wrapped index is never mistaken for a fresh one.
+
+struct TSseqpipeview
+{
+		/// Sequence number of the first slot.
+		unsigned char *seqs;
+
+		/// First element.
+		unsigned char *buffer;
+
+		/// Size of an element in bytes, distance in bytes between two slots.
+		size_t size;
+		size_t stride;
+
+		/// Number of elements minus one, the number of elements is always a power of two.
+		uint32_t mask;
+
+		/// Position of the next element to write, changed only by the writer.
+		uint32_t volatile *writeIndex;
+
+		/// Position of the oldest element, claimed by readers and, for the last element, by
+		/// the writer.
+		uint32_t volatile *readIndex;
+};
+
+typedef struct TSseqpipeview TSseqpipeview;
+
+static inline uint32_t volatile *__attribute__((always_inline))
+tsSeqPipeViewSeq(TSseqpipeview view, uint32_t slot)
+{
+		return (uint32_t volatile *)(view.seqs + slot * view.stride);
+}
+
+static inline unsigned char *__attribute__((always_inline))
+tsSeqPipeViewElement(TSseqpipeview view, uint32_t slot)
+{
+		return view.buffer + slot * view.stride;
+}
+
+/// Not intended for general use. Should only be used very prudently.
+static inline int __attribute__((always_inline))
+tsSeqPipeViewIsEmpty(TSseqpipeview view)
+{
+		uint32_t readIndex = tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+		return (int32_t)(writeIndex - readIndex) <= 0;
+}
+
+/// Return 0 if we were unable to read.
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsSeqPipeViewReaderTryReadBack(TSseqpipeview view, void *out)
+{
+		while (1)
+		{
+				uint32_t readIndex = tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE);
+
+				// Pairs with the fence in "tsSeqPipeViewWriterTryReadFront", either we see the
+				// writer taking the last element back or it sees us claiming it.
+				tsAtomicThreadFence(TS_SEQ_CST);
+				uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_ACQUIRE);
+				if ((int32_t)(writeIndex - readIndex) <= 0) return 0;
+
+				// The slot must hold the element at "readIndex" and not one of another lap.
+				uint32_t slot = readIndex & view.mask;
+				uint32_t volatile *seq = tsSeqPipeViewSeq(view, slot);
+				if (tsAtomicLoad_u32(seq, TS_ACQUIRE) != readIndex + 1) continue;
+
+				uint32_t expected = readIndex;
+				uint32_t desired = readIndex + 1;
+				if (tsAtomicCmpXchg_u32(view.readIndex, &expected, &desired, 0, TS_SEQ_CST, TS_RELAXED))
+				{
+						memcpy(out, tsSeqPipeViewElement(view, slot), view.size);
+
+						// Hand the slot on to the element one lap ahead.
+						tsAtomicStore_u32(seq, readIndex + view.mask + 1, TS_RELEASE);
+						return 1;
+				}
+
+				// Another reader got it, go straight for the element after it.
+		}
+}
+
+/// "tsSeqPipeViewWriterTryReadFront" returns 0 if we were unable to read.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsSeqPipeViewWriterTryReadFront(TSseqpipeview view, void *out)
+{
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED) - 1;
+
+		// Take the element back first, then look at what the readers left us.
+		tsAtomicStore_u32(view.writeIndex, writeIndex, TS_RELAXED);
+		tsAtomicThreadFence(TS_SEQ_CST);
+		uint32_t readIndex = tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
+
+		int32_t numLeft = (int32_t)(writeIndex - readIndex);
+		if (numLeft < 0)
+		{
+				tsAtomicStore_u32(view.writeIndex, writeIndex + 1, TS_RELAXED);
+				return 0;
+		}
+
+		uint32_t slot = writeIndex & view.mask;
+		uint32_t volatile *seq = tsSeqPipeViewSeq(view, slot);
+		if (numLeft > 0)
+		{
+				// No reader can reach this element any more.
+				memcpy(out, tsSeqPipeViewElement(view, slot), view.size);
+				tsAtomicStore_u32(seq, writeIndex, TS_RELEASE);
+				return 1;
+		}
+
+		// The last element, claim it the way readers do.
+		uint32_t expected = readIndex;
+		uint32_t desired = readIndex + 1;
+		TSbool success =
+		    tsAtomicCmpXchg_u32(view.readIndex, &expected, &desired, 0, TS_SEQ_CST, TS_RELAXED);
+		tsAtomicStore_u32(view.writeIndex, writeIndex + 1, TS_RELAXED);
+		if (!success) return 0;
+
+		memcpy(out, tsSeqPipeViewElement(view, slot), view.size);
+		tsAtomicStore_u32(seq, writeIndex + view.mask + 1, TS_RELEASE);
+		return 1;
+}
+
+/// WriterTryWriteFront returns false if we were unable to write
+/// This is thread safe for the single writer, but should not be called by readers
+static inline int __attribute__((always_inline))
+tsSeqPipeViewWriterTryWriteFront(TSseqpipeview view, const void *in)
+{
+		uint32_t writeIndex = *view.writeIndex;
+		uint32_t slot = writeIndex & view.mask;
+		uint32_t volatile *seq = tsSeqPipeViewSeq(view, slot);
+
+		// Until the reader of the element one lap behind has let go of the slot, we are full.
+		if (tsAtomicLoad_u32(seq, TS_ACQUIRE) != writeIndex) return 0;
+
+		memcpy(tsSeqPipeViewElement(view, slot), in, view.size);
+		tsAtomicStore_u32(seq, writeIndex + 1, TS_RELEASE);
+		tsAtomicStore_u32(view.writeIndex, writeIndex + 1, TS_RELEASE);
+		return 1;
+}
+
+/// Define sequence-numbered pipe "Name" holding "1 << log2size" elements of "type", with the
+/// same "prefix##*" functions as "TS_PIPE_DEFINE" except the batched ones.
+#define TS_SEQPIPE_DEFINE(Name, prefix, type, log2size) \
+		TS_STATIC_ASSERT((log2size) < 31, #Name ": log2size must be less than 31"); \
+		struct Name##slot \
+		{ \
+				uint32_t volatile seq; \
+				type data; \
+		}; \
+		struct Name \
+		{ \
+				struct Name##slot slots[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex TS_PIPE_INDEX_ALIGN_; \
+		}; \
+		typedef struct Name Name; \
+		static inline TSseqpipeview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TSseqpipeview view; \
+				view.seqs = (unsigned char *)&pipe->slots[0].seq; \
+				view.buffer = (unsigned char *)&pipe->slots[0].data; \
+				view.size = sizeof(type); \
+				view.stride = sizeof(struct Name##slot); \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndex = &pipe->readIndex; \
+				return view; \
+		} \
+		/* Initialize the pipe. Except the elements, clear the other bytes of the pipe. */ \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				for (uint32_t i = 0; i < ((uint32_t)1 << (log2size)); ++i) pipe->slots[i].seq = i; \
+				pipe->writeIndex = 0; \
+				pipe->readIndex = 0; \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsSeqPipeViewIsEmpty(prefix##View(pipe)); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, type *out) \
+		{ \
+				return tsSeqPipeViewReaderTryReadBack(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, type *out) \
+		{ \
+				return tsSeqPipeViewWriterTryReadFront(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, type *in) \
+		{ \
+				return tsSeqPipeViewWriterTryWriteFront(prefix##View(pipe), in); \
+		}
+
+/// The default sequence-numbered pipe, "TS_PIPE_SIZE" elements of "TSpipedata".
+TS_SEQPIPE_DEFINE(TSseqpipe, tsSeqPipe, TSpipedata, TS_PIPE_SIZE_LOG2)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_SEQ_H
@@ -0,0 +1,207 @@
+#ifndef PIPE_SPSC_H
+#define PIPE_SPSC_H
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Single-reader pipe ---------------------------------------------------------------------
+//
+// A pipe for links with exactly one writer and one reader. With no other reader to race,
+// neither side needs a flag per slot nor a compare exchange: each owns its index, stores it
+// with release once the element is written or read, and loads the other side's with
+// acquire to know how far it may go.
+//
+// Each side also keeps a copy of the other's index on its own cache line and only loads
+// the real one when the copy says the pipe is full (for the writer) or empty (for the
+// reader). While the pipe is neither, the two sides do not touch each other's line at all.
+//
+// The writer can not take elements back from the front, that would race the reader for
+// the last one.
+
+/// Where a pipe keeps its data and indices, see "TSpipeview".
+struct TSspscview
+{
+		unsigned char *buffer;
+		size_t size;
+		uint32_t mask;
+
+		/// Written only by the writer, with its copy of "readIndex".
+		uint32_t volatile *writeIndex;
+		uint32_t *readIndexCache;
+
+		/// Written only by the reader, with its copy of "writeIndex".
+		uint32_t volatile *readIndex;
+		uint32_t *writeIndexCache;
+};
+
+typedef struct TSspscview TSspscview;
+
+static inline void
+tsSpscViewInit(TSspscview view)
+{
+		*view.writeIndex = 0;
+		*view.readIndexCache = 0;
+		*view.readIndex = 0;
+		*view.writeIndexCache = 0;
+}
+
+/// Not intended for general use, the answer may be stale by the time it is returned.
+static inline int __attribute__((always_inline))
+tsSpscViewIsEmpty(TSspscview view)
+{
+		return tsAtomicLoad_u32(view.writeIndex, TS_RELAXED) ==
+		    tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
+}
+
+/// Return 0 if we were unable to read. Only the reader may call it.
+static inline int __attribute__((always_inline))
+tsSpscViewReaderTryReadBack(TSspscview view, void *out)
+{
+		uint32_t readIndex = *view.readIndex;
+		if (readIndex == *view.writeIndexCache)
+		{
+				*view.writeIndexCache = tsAtomicLoad_u32(view.writeIndex, TS_ACQUIRE);
+				if (readIndex == *view.writeIndexCache)
+				{
+						TS_TRACE_EVENT_(TS_TRACE_STEAL_EMPTY, 0);
+						return 0;
+				}
+		}
+
+		memcpy(out, view.buffer + (size_t)(readIndex & view.mask) * view.size, view.size);
+
+		// Hands the slot back to the writer, the copy above must be done by then.
+		tsAtomicStore_u32(view.readIndex, readIndex + 1, TS_RELEASE);
+		TS_TRACE_EVENT_(TS_TRACE_STEAL, 1);
+		return 1;
+}
+
+/// Write up to "n" elements of "in" and publish them with a single store, the first one
+/// being the oldest. Return the number of elements written, 0 if the pipe is full.
+/// Only the writer may call it.
+static inline uint32_t __attribute__((always_inline))
+tsSpscViewWriterTryWriteFrontN(TSspscview view, const void *in, uint32_t n)
+{
+		uint32_t writeIndex = *view.writeIndex;
+		uint32_t space = view.mask + 1 - (writeIndex - *view.readIndexCache);
+		if (space < n)
+		{
+				*view.readIndexCache = tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE);
+				space = view.mask + 1 - (writeIndex - *view.readIndexCache);
+				if (space < n) n = space;
+		}
+
+		for (uint32_t i = 0; i < n; ++i)
+		{
+				memcpy(view.buffer + (size_t)((writeIndex + i) & view.mask) * view.size,
+				    (const unsigned char *)in + (size_t)i * view.size,
+				    view.size);
+		}
+
+		// Publishes the elements, the reader never looks past the write index.
+		if (n) tsAtomicStore_u32(view.writeIndex, writeIndex + n, TS_RELEASE);
+		if (n) TS_TRACE_EVENT_(TS_TRACE_PUSH, n);
+		else TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+		return n;
+}
+
+/// Return 0 if we were unable to write. Only the writer may call it.
+static inline int __attribute__((always_inline))
+tsSpscViewWriterTryWriteFront(TSspscview view, const void *in)
+{
+		return tsSpscViewWriterTryWriteFrontN(view, in, 1) != 0;
+}
+
+/// Slot the next element goes to, NULL if the pipe is full. Publish the element built there
+/// with "tsSpscViewWriterCommitFront". Only the writer may call it.
+static inline void *__attribute__((always_inline))
+tsSpscViewWriterReserveFront(TSspscview view)
+{
+		uint32_t writeIndex = *view.writeIndex;
+		if (writeIndex - *view.readIndexCache > view.mask)
+		{
+				*view.readIndexCache = tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE);
+				if (writeIndex - *view.readIndexCache > view.mask)
+				{
+						TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+						return NULL;
+				}
+		}
+		return view.buffer + (size_t)(writeIndex & view.mask) * view.size;
+}
+
+static inline void __attribute__((always_inline))
+tsSpscViewWriterCommitFront(TSspscview view)
+{
+		tsAtomicStore_u32(view.writeIndex, *view.writeIndex + 1, TS_RELEASE);
+		TS_TRACE_EVENT_(TS_TRACE_PUSH, 1);
+}
+
+/// Define a pipe type "Name" of "1 << log2size" elements of "type" for one writer and one
+/// reader, and functions "prefix##Init", "prefix##IsEmpty", "prefix##ReaderTryReadBack",
+/// "prefix##WriterTryWriteFront", "prefix##WriterTryWriteFrontN",
+/// "prefix##WriterReserveFront" and "prefix##WriterCommitFront" that behave like those of
+/// "TS_PIPE_DEFINE".
+#define TS_SPSC_PIPE_DEFINE(Name, prefix, type, log2size) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name \
+		{ \
+				type buffer[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+				uint32_t readIndexCache; \
+				uint32_t volatile readIndex __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+				uint32_t writeIndexCache; \
+		} __attribute__((aligned(TS_PIPE_CACHE_LINE_SIZE))); \
+		typedef struct Name Name; \
+		static inline TSspscview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TSspscview view; \
+				view.buffer = (unsigned char *)pipe->buffer; \
+				view.size = sizeof(type); \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndexCache = &pipe->readIndexCache; \
+				view.readIndex = &pipe->readIndex; \
+				view.writeIndexCache = &pipe->writeIndexCache; \
+				return view; \
+		} \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				tsSpscViewInit(prefix##View(pipe)); \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsSpscViewIsEmpty(prefix##View(pipe)); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, type *out) \
+		{ \
+				return tsSpscViewReaderTryReadBack(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, type *in) \
+		{ \
+				return tsSpscViewWriterTryWriteFront(prefix##View(pipe), in); \
+		} \
+		static inline uint32_t prefix##WriterTryWriteFrontN(Name *pipe, type *items, uint32_t n) \
+		{ \
+				return tsSpscViewWriterTryWriteFrontN(prefix##View(pipe), items, n); \
+		} \
+		static inline type *prefix##WriterReserveFront(Name *pipe) \
+		{ \
+				return (type *)tsSpscViewWriterReserveFront(prefix##View(pipe)); \
+		} \
+		static inline void prefix##WriterCommitFront(Name *pipe) \
+		{ \
+				tsSpscViewWriterCommitFront(prefix##View(pipe)); \
+		}
+
+/// The default single-reader pipe, as many elements of "TSpipedata" as "TSpipe".
+TS_SPSC_PIPE_DEFINE(TSspscpipe, tsSpscPipe, TSpipedata, TS_PIPE_SIZE_LOG2)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_SPSC_H
@@ -0,0 +1,452 @@
+#ifndef PIPE_TAGGED_H
+#define PIPE_TAGGED_H
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Tagged pipe ----------------------------------------------------------------------------
+//
+// A pipe of 63-bit payloads, task handles, indices or pointers, whose slots need no flag:
+// the top bit of a slot tells whether it is readable and the payload is in the rest of it.
+// A reader claims a slot and reads its payload with the same compare exchange, swapping
+// what it loaded for "TS_TAGGED_WRITABLE", so a steal touches the slot's cache line only
+// instead of a flag's line and an element's line. With the payload read by then, there is
+// nothing to hold the slot for, it goes straight back to the writer and there is no
+// "TS_PIPE_INVALID" state. Otherwise the protocol is the one of "TSpipeview".
+
+/// Top bit of a slot holding a payload. Payloads must leave it clear.
+#define TS_TAGGED_READABLE ((uint64_t)1 << 63)
+
+/// A slot the writer may fill.
+#define TS_TAGGED_WRITABLE ((uint64_t)0)
+
+/// Where a pipe keeps its slots and indices, see "TSpipeview".
+struct TStaggedview
+{
+		uint64_t volatile *slots;
+		uint32_t mask;
+		uint32_t volatile *writeIndex;
+		uint32_t volatile *readIndex;
+		uint32_t volatile *readCount;
+};
+
+typedef struct TStaggedview TStaggedview;
+
+static inline void
+tsTaggedViewInit(TStaggedview view)
+{
+		for (uint32_t i = 0; i <= view.mask; ++i) view.slots[i] = TS_TAGGED_WRITABLE;
+		*view.writeIndex = 0;
+		*view.readIndex = 0;
+		*view.readCount = 0;
+}
+
+/// Not intended for general use, the answer may be stale by the time it is returned.
+static inline int __attribute__((always_inline))
+tsTaggedViewIsEmpty(TStaggedview view)
+{
+		return tsAtomicLoad_u32(view.writeIndex, TS_RELAXED) ==
+		    tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+}
+
+/// Take the payload of "slot" if it is readable, leaving the slot writable.
+static inline int __attribute__((always_inline))
+tsTaggedViewTake_(TStaggedview view, uint32_t slot, uint64_t *out, int weak)
+{
+		uint64_t volatile *word = &view.slots[slot];
+		uint64_t expected = tsAtomicLoad_u64(word, TS_RELAXED);
+		uint64_t desired = TS_TAGGED_WRITABLE;
+		if (!(expected & TS_TAGGED_READABLE)) return 0;
+		if (!tsAtomicCmpXchg_u64(word, &expected, &desired, weak, TS_ACQ_REL, TS_RELAXED))
+		{
+				return 0;
+		}
+		*out = expected & ~TS_TAGGED_READABLE;
+		return 1;
+}
+
+/// Return 0 if we were unable to read, see "tsPipeViewReaderClaimBackN".
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsTaggedViewReaderTryReadBack(TStaggedview view, uint64_t *out)
+{
+		uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+		uint32_t readIndexToUse = readCount;
+		while (1)
+		{
+				uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+				if (writeIndex == readCount)
+				{
+						TS_PIPE_STAT_ADD_(readerEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_STEAL_EMPTY, 0);
+						return 0;
+				}
+
+				if (readIndexToUse >= writeIndex)
+				{
+						TS_PIPE_STAT_ADD_(readerRestarts, 1);
+						readIndexToUse = tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
+				}
+
+				if (tsTaggedViewTake_(view, readIndexToUse & view.mask, out, 1)) break;
+				TS_PIPE_STAT_ADD_(readerCasFailures, 1);
+
+				++readIndexToUse;
+				readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+		}
+
+		tsAtomicFetchAdd_u32(view.readCount, 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(readerReads, 1);
+		TS_TRACE_EVENT_(TS_TRACE_STEAL, 1);
+		return 1;
+}
+
+/// Return 0 if we were unable to read, see "tsPipeViewWriterClaimFront".
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsTaggedViewWriterTryReadFront(TStaggedview view, uint64_t *out)
+{
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+		uint32_t frontReadIndex = writeIndex;
+		while (1)
+		{
+				uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+				if (writeIndex == readCount)
+				{
+						TS_PIPE_STAT_ADD_(writerPopEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
+						tsAtomicStore_u32(view.readIndex, readCount, TS_RELEASE);
+						return 0;
+				}
+				--frontReadIndex;
+				if (tsTaggedViewTake_(view, frontReadIndex & view.mask, out, 1)) break;
+				TS_PIPE_STAT_ADD_(writerPopCasFailures, 1);
+				if (tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE) >= frontReadIndex)
+				{
+						TS_PIPE_STAT_ADD_(writerPopLost, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
+						return 0;
+				}
+		}
+
+		tsAtomicStore_u32(view.writeIndex, writeIndex - 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPops, 1);
+		TS_TRACE_EVENT_(TS_TRACE_POP, 1);
+		return 1;
+}
+
+/// Return 0 if we were unable to write. "in" must leave "TS_TAGGED_READABLE" clear.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsTaggedViewWriterTryWriteFront(TStaggedview view, uint64_t in)
+{
+		uint32_t writeIndex = *view.writeIndex;
+		uint64_t volatile *word = &view.slots[writeIndex & view.mask];
+
+		// A reader may not have taken the payload of the previous lap yet.
+		if (tsAtomicLoad_u64(word, TS_ACQUIRE) != TS_TAGGED_WRITABLE)
+		{
+				TS_PIPE_STAT_ADD_(writerFull, 1);
+				TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+				return 0;
+		}
+
+		tsAtomicStore_u64(word, in | TS_TAGGED_READABLE, TS_RELEASE);
+		tsAtomicFetchAdd_u32(view.writeIndex, 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPushes, 1);
+		TS_TRACE_EVENT_(TS_TRACE_PUSH, 1);
+		return 1;
+}
+
+/// Define a pipe type "Name" of "1 << log2size" payloads, and functions "prefix##Init",
+/// "prefix##IsEmpty", "prefix##ReaderTryReadBack", "prefix##WriterTryReadFront" and
+/// "prefix##WriterTryWriteFront" that behave like those of "TS_PIPE_DEFINE", for payloads
+/// of type "uint64_t" with the top bit clear.
+#define TS_TAGGED_PIPE_DEFINE(Name, prefix, log2size) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name \
+		{ \
+				uint64_t volatile slots[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex __attribute__((aligned(4))); \
+				uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_; \
+		}; \
+		typedef struct Name Name; \
+		static inline TStaggedview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TStaggedview view; \
+				view.slots = pipe->slots; \
+				view.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.writeIndex = &pipe->writeIndex; \
+				view.readIndex = &pipe->readIndex; \
+				view.readCount = &pipe->readCount; \
+				return view; \
+		} \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				tsTaggedViewInit(prefix##View(pipe)); \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsTaggedViewIsEmpty(prefix##View(pipe)); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, uint64_t *out) \
+		{ \
+				return tsTaggedViewReaderTryReadBack(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, uint64_t *out) \
+		{ \
+				return tsTaggedViewWriterTryReadFront(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, uint64_t in) \
+		{ \
+				return tsTaggedViewWriterTryWriteFront(prefix##View(pipe), in); \
+		}
+
+/// The default tagged pipe, as many payloads as "TSpipe" has elements.
+TS_TAGGED_PIPE_DEFINE(TStaggedpipe, tsTaggedPipe, TS_PIPE_SIZE_LOG2)
+
+// Tagged pair pipe -----------------------------------------------------------------------
+//
+// The same for 16-byte payloads, like a task's function and argument: "first" carries
+// "TS_TAGGED_READABLE" and a reader takes both halves with one 16-byte compare exchange,
+// where the pipe of "TS_PIPE_DEFINE" would claim a flag and then copy the element from
+// another line. Where "tsAtomicHasCmpXchg_u128" says no, or with "TS_PIPE_NO_WIDE_CAS"
+// defined, the pipe falls back to the flag protocol of "TSpipeview" on the same slots. The
+// choice is made once in "Init", "IsWide" tells which it was.
+
+/// Payload of a pair pipe, "first" must leave "TS_TAGGED_READABLE" clear.
+struct TStaggedpair
+{
+		uint64_t first;
+		uint64_t second;
+} __attribute__((aligned(16)));
+
+typedef struct TStaggedpair TStaggedpair;
+
+/// A pipe view of pairs, and whether slots carry their own state.
+struct TStaggedpairview
+{
+		TSpipeview pipe;
+		int wide;
+};
+
+typedef struct TStaggedpairview TStaggedpairview;
+
+/// Whether pair pipes created now can use "tsAtomicCmpXchg_u128".
+static inline int
+tsTaggedPairWideSupported(void)
+{
+#if defined TS_ATOMIC_CMPXCHG_U128_ && !defined TS_PIPE_NO_WIDE_CAS
+		return tsAtomicHasCmpXchg_u128();
+#else
+		return 0;
+#endif
+}
+
+/// Take both halves of "slot" if it is readable, leaving it writable. Only for wide views.
+static inline int __attribute__((always_inline))
+tsTaggedPairViewTake_(TSpipeview view, uint32_t slot, TStaggedpair *out)
+{
+#if defined TS_ATOMIC_CMPXCHG_U128_ && !defined TS_PIPE_NO_WIDE_CAS
+		uint64_t volatile *words = (uint64_t volatile *)tsPipeViewElement(view, slot);
+
+		// The halves may be torn between two writes, the compare exchange then fails.
+		uint64_t first = tsAtomicLoad_u64(&words[0], TS_RELAXED);
+		if (!(first & TS_TAGGED_READABLE)) return 0;
+		uint64_t second = tsAtomicLoad_u64(&words[1], TS_RELAXED);
+
+		unsigned __int128 expected = ((unsigned __int128)second << 64) | first;
+		unsigned __int128 desired = 0;
+		if (!tsAtomicCmpXchg_u128((unsigned __int128 volatile *)words, &expected, &desired))
+		{
+				return 0;
+		}
+		out->first = first & ~TS_TAGGED_READABLE;
+		out->second = second;
+		return 1;
+#else
+		(void)view;
+		(void)slot;
+		(void)out;
+		return 0;
+#endif
+}
+
+/// Return 0 if we were unable to read, see "tsTaggedViewReaderTryReadBack".
+/// Thread safe for both multiple readers and the writer.
+static inline int __attribute__((always_inline))
+tsTaggedPairViewReaderTryReadBack(TStaggedpairview pairs, TStaggedpair *out)
+{
+		TSpipeview view = pairs.pipe;
+		if (!pairs.wide) return tsPipeViewReaderTryReadBack(view, out);
+
+		uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+		uint32_t readIndexToUse = readCount;
+		while (1)
+		{
+				uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+				if (writeIndex == readCount)
+				{
+						TS_PIPE_STAT_ADD_(readerEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_STEAL_EMPTY, 0);
+						return 0;
+				}
+
+				if (readIndexToUse >= writeIndex)
+				{
+						TS_PIPE_STAT_ADD_(readerRestarts, 1);
+						readIndexToUse = tsAtomicLoad_u32(view.readIndex, TS_RELAXED);
+				}
+
+				if (tsTaggedPairViewTake_(view, readIndexToUse & view.mask, out)) break;
+				TS_PIPE_STAT_ADD_(readerCasFailures, 1);
+
+				++readIndexToUse;
+				readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+		}
+
+		tsAtomicFetchAdd_u32(view.readCount, 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(readerReads, 1);
+		TS_TRACE_EVENT_(TS_TRACE_STEAL, 1);
+		return 1;
+}
+
+/// Return 0 if we were unable to read, see "tsTaggedViewWriterTryReadFront".
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsTaggedPairViewWriterTryReadFront(TStaggedpairview pairs, TStaggedpair *out)
+{
+		TSpipeview view = pairs.pipe;
+		if (!pairs.wide) return tsPipeViewWriterTryReadFront(view, out);
+
+		uint32_t writeIndex = tsAtomicLoad_u32(view.writeIndex, TS_RELAXED);
+		uint32_t frontReadIndex = writeIndex;
+		while (1)
+		{
+				uint32_t readCount = tsAtomicLoad_u32(view.readCount, TS_RELAXED);
+				if (writeIndex == readCount)
+				{
+						TS_PIPE_STAT_ADD_(writerPopEmpty, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
+						tsAtomicStore_u32(view.readIndex, readCount, TS_RELEASE);
+						return 0;
+				}
+				--frontReadIndex;
+				if (tsTaggedPairViewTake_(view, frontReadIndex & view.mask, out)) break;
+				TS_PIPE_STAT_ADD_(writerPopCasFailures, 1);
+				if (tsAtomicLoad_u32(view.readIndex, TS_ACQUIRE) >= frontReadIndex)
+				{
+						TS_PIPE_STAT_ADD_(writerPopLost, 1);
+						TS_TRACE_EVENT_(TS_TRACE_POP_EMPTY, 0);
+						return 0;
+				}
+		}
+
+		tsAtomicStore_u32(view.writeIndex, writeIndex - 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPops, 1);
+		TS_TRACE_EVENT_(TS_TRACE_POP, 1);
+		return 1;
+}
+
+/// Return 0 if we were unable to write.
+/// This is thread safe for the single writer, but should not be called by readers.
+static inline int __attribute__((always_inline))
+tsTaggedPairViewWriterTryWriteFront(TStaggedpairview pairs, TStaggedpair *in)
+{
+		TSpipeview view = pairs.pipe;
+		if (!pairs.wide) return tsPipeViewWriterTryWriteFront(view, in);
+
+		uint32_t writeIndex = *view.writeIndex;
+		uint64_t volatile *words =
+		    (uint64_t volatile *)tsPipeViewElement(view, writeIndex & view.mask);
+
+		// A reader may not have taken the pair of the previous lap yet.
+		if (tsAtomicLoad_u64(&words[0], TS_ACQUIRE) & TS_TAGGED_READABLE)
+		{
+				TS_PIPE_STAT_ADD_(writerFull, 1);
+				TS_TRACE_EVENT_(TS_TRACE_PUSH_FULL, 0);
+				return 0;
+		}
+
+		// "second" first, readers only look at it once "first" is tagged.
+		tsAtomicStore_u64(&words[1], in->second, TS_RELAXED);
+		tsAtomicStore_u64(&words[0], in->first | TS_TAGGED_READABLE, TS_RELEASE);
+		tsAtomicFetchAdd_u32(view.writeIndex, 1, TS_RELAXED);
+		TS_PIPE_STAT_ADD_(writerPushes, 1);
+		TS_TRACE_EVENT_(TS_TRACE_PUSH, 1);
+		return 1;
+}
+
+/// Define a pipe type "Name" of "1 << log2size" elements of "TStaggedpair", and functions
+/// "prefix##Init", "prefix##IsEmpty", "prefix##IsWide", "prefix##ReaderTryReadBack",
+/// "prefix##WriterTryReadFront" and "prefix##WriterTryWriteFront" that behave like those
+/// of "TS_PIPE_DEFINE". The flags are only touched by the fallback protocol.
+#define TS_TAGGED_PAIR_PIPE_DEFINE(Name, prefix, log2size) \
+		TS_STATIC_ASSERT((log2size) < 32, #Name ": log2size must be less than 32"); \
+		struct Name \
+		{ \
+				TStaggedpair buffer[(size_t)1 << (log2size)]; \
+				TSpipeflag volatile flags[(size_t)1 << (log2size)]; \
+				uint32_t volatile writeIndex TS_PIPE_INDEX_ALIGN_; \
+				uint32_t volatile readIndex __attribute__((aligned(4))); \
+				uint32_t volatile readCount TS_PIPE_INDEX_ALIGN_; \
+				int wide; \
+		}; \
+		typedef struct Name Name; \
+		static inline TStaggedpairview __attribute__((always_inline)) prefix##View(Name *pipe) \
+		{ \
+				TStaggedpairview view; \
+				view.pipe.buffer = (unsigned char *)pipe->buffer; \
+				view.pipe.flags = (unsigned char *)pipe->flags; \
+				view.pipe.size = sizeof(TStaggedpair); \
+				view.pipe.stride = sizeof(TStaggedpair); \
+				view.pipe.flagStride = sizeof(TSpipeflag); \
+				view.pipe.mask = ((uint32_t)1 << (log2size)) - 1; \
+				view.pipe.writeIndex = &pipe->writeIndex; \
+				view.pipe.readIndex = &pipe->readIndex; \
+				view.pipe.readCount = &pipe->readCount; \
+				view.wide = pipe->wide; \
+				return view; \
+		} \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				memset((void *)pipe->buffer, 0, sizeof(pipe->buffer)); \
+				memset((void *)pipe->flags, 0, sizeof(pipe->flags)); \
+				pipe->readIndex = 0; \
+				pipe->writeIndex = 0; \
+				pipe->readCount = 0; \
+				pipe->wide = tsTaggedPairWideSupported(); \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return tsPipeViewIsEmpty(prefix##View(pipe).pipe); \
+		} \
+		static inline int prefix##IsWide(Name *pipe) \
+		{ \
+				return pipe->wide; \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, TStaggedpair *out) \
+		{ \
+				return tsTaggedPairViewReaderTryReadBack(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, TStaggedpair *out) \
+		{ \
+				return tsTaggedPairViewWriterTryReadFront(prefix##View(pipe), out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, TStaggedpair *in) \
+		{ \
+				return tsTaggedPairViewWriterTryWriteFront(prefix##View(pipe), in); \
+		}
+
+/// The default tagged pair pipe, as many pairs as "TSpipe" has elements.
+TS_TAGGED_PAIR_PIPE_DEFINE(TStaggedpairpipe, tsTaggedPairPipe, TS_PIPE_SIZE_LOG2)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_TAGGED_H
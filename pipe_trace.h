@@ -0,0 +1,209 @@
+#ifndef PIPE_TRACE_H
+#define PIPE_TRACE_H
+
+// Event recorder ---------------------------------------------------------------------------
+//
+// Define "TS_PIPE_TRACE" to have every thread record what it does with pipes and tasks
+// (pushes, pops and steals, successful or not, tasks beginning and ending, idle threads
+// parking and waking up) with a time stamp counter reading, into a ring buffer of its own.
+// "tsTraceWrite" turns all of them into a Chrome trace that Perfetto or chrome://tracing
+// can show as one timeline per thread. Recording costs a few stores into memory no other
+// thread touches; without "TS_PIPE_TRACE" it compiles to nothing.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+enum TStraceevent
+{
+		TS_TRACE_PUSH,
+		TS_TRACE_PUSH_FULL,
+		TS_TRACE_POP,
+		TS_TRACE_POP_EMPTY,
+		TS_TRACE_STEAL,
+		TS_TRACE_STEAL_EMPTY,
+		TS_TRACE_TASK_BEGIN,
+		TS_TRACE_TASK_END,
+		TS_TRACE_PARK,
+		TS_TRACE_UNPARK
+};
+
+#ifdef TS_PIPE_TRACE
+
+#		include <pthread.h>
+#		include <stdio.h>
+#		include <stdlib.h>
+#		include <time.h>
+
+#		if defined __i386__ || defined __x86_64__
+#				include <x86intrin.h>
+#		endif
+
+#		ifndef TS_TRACE_CAPACITY_LOG2
+/// Events every thread keeps, older ones are overwritten.
+#				define TS_TRACE_CAPACITY_LOG2 16
+#		endif // TS_TRACE_CAPACITY_LOG2
+
+struct TStracerecord
+{
+		uint64_t ticks;
+		uint32_t event;
+
+		/// Elements moved by a push or steal, 0 otherwise.
+		uint32_t count;
+};
+
+struct TStracebuffer
+{
+		struct TStracerecord records[(size_t)1 << TS_TRACE_CAPACITY_LOG2];
+
+		/// Events recorded so far, the newest one is at "(recorded - 1) & mask".
+		uint64_t volatile recorded;
+
+		struct TStracebuffer *next;
+		uint32_t thread;
+};
+
+/// Time stamp counter reading and clock at the first record, "tsTraceWrite" converts
+/// ticks to time from them.
+struct TStraceclock
+{
+		uint64_t ticks;
+		uint64_t ns;
+};
+
+// Weak, so that every translation unit including this header shares them.
+__attribute__((weak)) __thread struct TStracebuffer *tsTraceThread_;
+__attribute__((weak)) struct TStracebuffer *tsTraceBuffers_;
+__attribute__((weak)) uint32_t tsTraceThreads_;
+__attribute__((weak)) struct TStraceclock tsTraceStart_;
+__attribute__((weak)) pthread_mutex_t tsTraceLock_ = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t __attribute__((always_inline))
+tsTraceTicks(void)
+{
+#		if defined __i386__ || defined __x86_64__
+		return __rdtsc();
+#		else
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#		endif
+}
+
+static inline uint64_t
+tsTraceNs_(void)
+{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline struct TStracebuffer *__attribute__((cold))
+tsTraceAttach_(void)
+{
+		struct TStracebuffer *buffer =
+		    (struct TStracebuffer *)calloc(1, sizeof(struct TStracebuffer));
+		if (!buffer) abort();
+
+		pthread_mutex_lock(&tsTraceLock_);
+		if (!tsTraceBuffers_)
+		{
+				tsTraceStart_.ticks = tsTraceTicks();
+				tsTraceStart_.ns = tsTraceNs_();
+		}
+		buffer->thread = tsTraceThreads_++;
+		buffer->next = tsTraceBuffers_;
+		tsTraceBuffers_ = buffer;
+		pthread_mutex_unlock(&tsTraceLock_);
+
+		tsTraceThread_ = buffer;
+		return buffer;
+}
+
+/// Record "event" for the calling thread.
+static inline void __attribute__((always_inline))
+tsTraceRecord(enum TStraceevent event, uint32_t count)
+{
+		struct TStracebuffer *buffer = tsTraceThread_;
+		if (__builtin_expect(buffer == NULL, 0)) buffer = tsTraceAttach_();
+
+		uint64_t recorded = buffer->recorded;
+		struct TStracerecord *record =
+		    &buffer->records[recorded & (((size_t)1 << TS_TRACE_CAPACITY_LOG2) - 1)];
+		record->ticks = tsTraceTicks();
+		record->event = (uint32_t)event;
+		record->count = count;
+
+		// Only tells "tsTraceWrite" how far to read, it is meant to run once threads are done.
+		__atomic_store_n(&buffer->recorded, recorded + 1, __ATOMIC_RELEASE);
+}
+
+/// Write the events of every thread that recorded any to "path" as a Chrome trace.
+/// Recording threads should be done by then. Return 0 if the file could not be written.
+static inline int
+tsTraceWrite(const char *path)
+{
+		static const char *const names[] = {"push", "push full", "pop", "pop empty", "steal",
+		    "steal empty", "task", "task", "parked", "parked"};
+		const size_t capacity = (size_t)1 << TS_TRACE_CAPACITY_LOG2;
+
+		FILE *file = fopen(path, "w");
+		if (!file) return 0;
+
+		pthread_mutex_lock(&tsTraceLock_);
+		double ticksPerUs = 1.0;
+		uint64_t elapsedNs = tsTraceNs_() - tsTraceStart_.ns;
+		uint64_t elapsedTicks = tsTraceTicks() - tsTraceStart_.ticks;
+		if (elapsedNs) ticksPerUs = (double)elapsedTicks * 1e3 / (double)elapsedNs;
+
+		int first = 1;
+		fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+		for (struct TStracebuffer *buffer = tsTraceBuffers_; buffer; buffer = buffer->next)
+		{
+				uint64_t end = __atomic_load_n(&buffer->recorded, __ATOMIC_ACQUIRE);
+				uint64_t begin = end > capacity ? end - capacity : 0;
+				fprintf(file, "%s\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, "
+								    "\"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+				    first ? "" : ",", buffer->thread, buffer->thread);
+				first = 0;
+
+				for (uint64_t i = begin; i < end; ++i)
+				{
+						const struct TStracerecord *record = &buffer->records[i & (capacity - 1)];
+						double us = (double)(int64_t)(record->ticks - tsTraceStart_.ticks) / ticksPerUs;
+						const char *phase = "i";
+						if (record->event == TS_TRACE_TASK_BEGIN || record->event == TS_TRACE_PARK)
+						{
+								phase = "B";
+						}
+						else if (record->event == TS_TRACE_TASK_END || record->event == TS_TRACE_UNPARK)
+						{
+								phase = "E";
+						}
+						fprintf(file, ",\n{\"ph\": \"%s\", \"name\": \"%s\", \"pid\": 1, \"tid\": %u, "
+										    "\"ts\": %.3f%s",
+						    phase, names[record->event], buffer->thread, us,
+						    phase[0] == 'i' ? ", \"s\": \"t\"" : "");
+						if (record->count) fprintf(file, ", \"args\": {\"count\": %u}", record->count);
+						fprintf(file, "}");
+				}
+		}
+		fprintf(file, "\n]}\n");
+		pthread_mutex_unlock(&tsTraceLock_);
+
+		return fclose(file) == 0;
+}
+
+#		define TS_TRACE_EVENT_(event, count) tsTraceRecord((event), (count))
+#else
+#		define TS_TRACE_EVENT_(event, count) ((void)0)
+#endif // TS_PIPE_TRACE
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_TRACE_H
@@ -0,0 +1,513 @@
+#ifndef PIPE_WAIT_H
+#define PIPE_WAIT_H
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef __linux__
+#		include <linux/futex.h>
+#		include <sys/syscall.h>
+#		include <unistd.h>
+#else
+#		include <pthread.h>
+#endif // __linux__
+
+#include "./pipe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// Event count ----------------------------------------------------------------------------
+//
+// Lets readers sleep until the writer has published something, without the writer paying
+// for it while nobody sleeps. A reader announces itself and takes the current "epoch",
+// checks the pipe once more, and only then sleeps until "epoch" moves. The writer publishes
+// first and then looks at "waiters": the full fences on both sides make sure that either
+// the reader's last check sees the element or the writer sees the reader, so no wake-up
+// gets lost and an uncontended push costs a fence and a load, never a system call.
+
+/// Timeout of "tsEventCountWait" to sleep until woken.
+#define TS_WAIT_FOREVER UINT64_MAX
+
+#ifndef TS_PIPE_WAIT_SPIN_COUNT
+/// Retries of the default wait strategy before a reader sleeps.
+#		define TS_PIPE_WAIT_SPIN_COUNT 100
+#endif // TS_PIPE_WAIT_SPIN_COUNT
+
+struct TSeventcount
+{
+		/// Moves on every notification that found waiters, sleepers wait for it to change.
+		uint32_t volatile epoch;
+
+		/// Readers between "tsEventCountPrepareWait" and the end of their wait.
+		uint32_t volatile waiters;
+
+#ifndef __linux__
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+#endif // __linux__
+};
+
+typedef struct TSeventcount TSeventcount;
+
+static inline void
+tsEventCountInit(TSeventcount *event)
+{
+		event->epoch = 0;
+		event->waiters = 0;
+#ifndef __linux__
+		pthread_mutex_init(&event->lock, NULL);
+		pthread_cond_init(&event->cond, NULL);
+#endif // __linux__
+}
+
+static inline void
+tsEventCountDestroy(TSeventcount *event)
+{
+#ifndef __linux__
+		pthread_mutex_destroy(&event->lock);
+		pthread_cond_destroy(&event->cond);
+#else
+		(void)event;
+#endif // __linux__
+}
+
+/// Announce the calling thread as about to sleep and return the key for
+/// "tsEventCountWait". Check the condition once more afterwards, then either wait or call
+/// "tsEventCountCancelWait".
+static inline uint32_t
+tsEventCountPrepareWait(TSeventcount *event)
+{
+		tsAtomicFetchAdd_u32(&event->waiters, 1, TS_SEQ_CST);
+		tsAtomicThreadFence(TS_SEQ_CST);
+		return tsAtomicLoad_u32(&event->epoch, TS_RELAXED);
+}
+
+static inline void
+tsEventCountCancelWait(TSeventcount *event)
+{
+		tsAtomicFetchAdd_u32(&event->waiters, (uint32_t)-1, TS_RELAXED);
+}
+
+/// Sleep until notified after "tsEventCountPrepareWait" returned "key", or for at most
+/// "timeoutNs" nanoseconds. May return early, the caller checks its condition again anyway.
+static inline void
+tsEventCountWait(TSeventcount *event, uint32_t key, uint64_t timeoutNs)
+{
+		struct timespec timeout;
+		timeout.tv_sec = (time_t)(timeoutNs / 1000000000u);
+		timeout.tv_nsec = (long)(timeoutNs % 1000000000u);
+
+#ifdef __linux__
+		// Returns right away with EAGAIN if "epoch" already moved.
+		syscall(SYS_futex, &event->epoch, FUTEX_WAIT_PRIVATE, key,
+		    timeoutNs == TS_WAIT_FOREVER ? NULL : &timeout, NULL, 0);
+#else
+		pthread_mutex_lock(&event->lock);
+		if (timeoutNs == TS_WAIT_FOREVER)
+		{
+				while (tsAtomicLoad_u32(&event->epoch, TS_ACQUIRE) == key)
+				{
+						pthread_cond_wait(&event->cond, &event->lock);
+				}
+		}
+		else if (tsAtomicLoad_u32(&event->epoch, TS_ACQUIRE) == key)
+		{
+				struct timespec deadline;
+				clock_gettime(CLOCK_REALTIME, &deadline);
+				deadline.tv_sec += timeout.tv_sec;
+				deadline.tv_nsec += timeout.tv_nsec;
+				if (deadline.tv_nsec >= 1000000000)
+				{
+						deadline.tv_sec += 1;
+						deadline.tv_nsec -= 1000000000;
+				}
+				pthread_cond_timedwait(&event->cond, &event->lock, &deadline);
+		}
+		pthread_mutex_unlock(&event->lock);
+#endif // __linux__
+
+		tsAtomicFetchAdd_u32(&event->waiters, (uint32_t)-1, TS_RELAXED);
+}
+
+static inline void
+tsEventCountWake_(TSeventcount *event, int all)
+{
+#ifdef __linux__
+		tsAtomicFetchAdd_u32(&event->epoch, 1, TS_SEQ_CST);
+		syscall(SYS_futex, &event->epoch, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, NULL, NULL, 0);
+#else
+		pthread_mutex_lock(&event->lock);
+		tsAtomicFetchAdd_u32(&event->epoch, 1, TS_SEQ_CST);
+		if (all) pthread_cond_broadcast(&event->cond);
+		else pthread_cond_signal(&event->cond);
+		pthread_mutex_unlock(&event->lock);
+#endif // __linux__
+}
+
+/// Wake one sleeper, if there is any. Call it after publishing what sleepers wait for.
+static inline void __attribute__((always_inline))
+tsEventCountNotifyOne(TSeventcount *event)
+{
+		tsAtomicThreadFence(TS_SEQ_CST);
+		if (tsAtomicLoad_u32(&event->waiters, TS_RELAXED) != 0) tsEventCountWake_(event, 0);
+}
+
+/// Wake every sleeper, if there is any.
+static inline void
+tsEventCountNotifyAll(TSeventcount *event)
+{
+		tsAtomicThreadFence(TS_SEQ_CST);
+		if (tsAtomicLoad_u32(&event->waiters, TS_RELAXED) != 0) tsEventCountWake_(event, 1);
+}
+
+// Wait strategies ------------------------------------------------------------------------
+//
+// How a reader spends the time until its pipe has something, trading wake-up latency
+// against CPU (as the wait strategies of the LMAX Disruptor):
+// - "TS_WAIT_SPIN", retry right away. Lowest latency, burns a core.
+// - "TS_WAIT_BACKOFF", pause between retries, twice as long after every failure up to
+//   "maxPauses". Leaves the core's resources to its sibling hyper-thread.
+// - "TS_WAIT_YIELD", give the core to other threads between retries.
+// - "TS_WAIT_PARK", pause for "spinCount" retries, then sleep on the pipe's event count
+//   until woken or for at most "parkTimeoutNs". Idle readers cost nothing, waking one
+//   costs a system call.
+
+enum TSwaitkind
+{
+		TS_WAIT_SPIN,
+		TS_WAIT_BACKOFF,
+		TS_WAIT_YIELD,
+		TS_WAIT_PARK
+};
+
+struct TSwaitstrategy
+{
+		enum TSwaitkind kind;
+
+		/// "TS_WAIT_PARK", retries before sleeping.
+		uint32_t spinCount;
+
+		/// "TS_WAIT_BACKOFF", longest run of pauses between two retries.
+		uint32_t maxPauses;
+
+		/// "TS_WAIT_PARK", longest sleep before retrying anyway, "TS_WAIT_FOREVER" for none.
+		uint64_t parkTimeoutNs;
+};
+
+typedef struct TSwaitstrategy TSwaitstrategy;
+
+static inline TSwaitstrategy
+tsWaitStrategy_(enum TSwaitkind kind, uint32_t spinCount, uint32_t maxPauses, uint64_t parkNs)
+{
+		TSwaitstrategy strategy;
+		strategy.kind = kind;
+		strategy.spinCount = spinCount;
+		strategy.maxPauses = maxPauses;
+		strategy.parkTimeoutNs = parkNs;
+		return strategy;
+}
+
+static inline TSwaitstrategy
+tsWaitSpin(void)
+{
+		return tsWaitStrategy_(TS_WAIT_SPIN, 0, 0, 0);
+}
+
+static inline TSwaitstrategy
+tsWaitBackoff(uint32_t maxPauses)
+{
+		return tsWaitStrategy_(TS_WAIT_BACKOFF, 0, maxPauses, 0);
+}
+
+static inline TSwaitstrategy
+tsWaitYield(void)
+{
+		return tsWaitStrategy_(TS_WAIT_YIELD, 0, 0, 0);
+}
+
+static inline TSwaitstrategy
+tsWaitPark(uint32_t spinCount, uint64_t parkTimeoutNs)
+{
+		return tsWaitStrategy_(TS_WAIT_PARK, spinCount, 0, parkTimeoutNs);
+}
+
+/// Tell the core we are spinning.
+static inline void __attribute__((always_inline))
+tsWaitPause(void)
+{
+#if defined __i386__ || defined __x86_64__
+		__builtin_ia32_pause();
+#elif defined __aarch64__ || defined __arm__
+		__asm__ volatile("yield");
+#endif
+}
+
+/// Spend one failed retry the way "strategy" says, "*failures" counts the failures since
+/// the last success and starts at 0. Return 1 if it is time to sleep instead.
+static inline int
+tsWaitStrategyIdle(const TSwaitstrategy *strategy, uint32_t *failures)
+{
+		switch (strategy->kind)
+		{
+				case TS_WAIT_SPIN: return 0;
+				case TS_WAIT_BACKOFF:
+				{
+						uint32_t pauses = *failures < 31 ? (uint32_t)1 << *failures : UINT32_MAX;
+						if (pauses >= strategy->maxPauses) pauses = strategy->maxPauses;
+						else ++*failures;
+						while (pauses--) tsWaitPause();
+						return 0;
+				}
+				case TS_WAIT_YIELD: sched_yield(); return 0;
+				case TS_WAIT_PARK:
+				{
+						if (*failures >= strategy->spinCount) return 1;
+						++*failures;
+						tsWaitPause();
+						return 0;
+				}
+		}
+		return 0;
+}
+
+/// Wait strategy of a pipe, changed while readers follow it. Readers copy it out with
+/// "tsWaitSharedLoad" and retry if "tsWaitSharedStore" was writing it meanwhile, "seq" is
+/// odd while it does (a sequence lock), so a reader never sees half of one strategy.
+struct TSwaitshared
+{
+		uint32_t volatile seq;
+		uint32_t volatile kind;
+		uint32_t volatile spinCount;
+		uint32_t volatile maxPauses;
+		uint64_t volatile parkTimeoutNs;
+};
+
+typedef struct TSwaitshared TSwaitshared;
+
+/// No other thread may use "shared" yet.
+static inline void
+tsWaitSharedInit(TSwaitshared *shared, TSwaitstrategy strategy)
+{
+		shared->seq = 0;
+		shared->kind = (uint32_t)strategy.kind;
+		shared->spinCount = strategy.spinCount;
+		shared->maxPauses = strategy.maxPauses;
+		shared->parkTimeoutNs = strategy.parkTimeoutNs;
+}
+
+/// Thread safe against readers and other calls of "tsWaitSharedStore".
+static inline void
+tsWaitSharedStore(TSwaitshared *shared, TSwaitstrategy strategy)
+{
+		uint32_t seq = tsAtomicLoad_u32(&shared->seq, TS_RELAXED);
+		while (1)
+		{
+				uint32_t odd = seq | 1;
+				if (!(seq & 1) &&
+				    tsAtomicCmpXchg_u32(&shared->seq, &seq, &odd, 1, TS_ACQUIRE, TS_RELAXED))
+				{
+						break;
+				}
+				tsWaitPause();
+				seq = tsAtomicLoad_u32(&shared->seq, TS_RELAXED);
+		}
+		tsAtomicStore_u32(&shared->kind, (uint32_t)strategy.kind, TS_RELAXED);
+		tsAtomicStore_u32(&shared->spinCount, strategy.spinCount, TS_RELAXED);
+		tsAtomicStore_u32(&shared->maxPauses, strategy.maxPauses, TS_RELAXED);
+		tsAtomicStore_u64(&shared->parkTimeoutNs, strategy.parkTimeoutNs, TS_RELAXED);
+		tsAtomicStore_u32(&shared->seq, seq + 2, TS_RELEASE);
+}
+
+/// Copy the strategy to "out" and return the sequence number it had, for
+/// "tsWaitSharedChanged".
+static inline uint32_t
+tsWaitSharedLoad(const TSwaitshared *shared, TSwaitstrategy *out)
+{
+		while (1)
+		{
+				uint32_t seq = tsAtomicLoad_u32(&shared->seq, TS_ACQUIRE);
+				if (seq & 1)
+				{
+						tsWaitPause();
+						continue;
+				}
+				out->kind = (enum TSwaitkind)tsAtomicLoad_u32(&shared->kind, TS_RELAXED);
+				out->spinCount = tsAtomicLoad_u32(&shared->spinCount, TS_RELAXED);
+				out->maxPauses = tsAtomicLoad_u32(&shared->maxPauses, TS_RELAXED);
+				out->parkTimeoutNs = tsAtomicLoad_u64(&shared->parkTimeoutNs, TS_RELAXED);
+				tsAtomicThreadFence(TS_ACQUIRE);
+				if (tsAtomicLoad_u32(&shared->seq, TS_RELAXED) == seq) return seq;
+		}
+}
+
+static inline int __attribute__((always_inline))
+tsWaitSharedChanged(const TSwaitshared *shared, uint32_t seq)
+{
+		return tsAtomicLoad_u32(&shared->seq, TS_RELAXED) != seq;
+}
+
+/// Whether readers may be parking, all the writer needs to know.
+static inline int __attribute__((always_inline))
+tsWaitSharedParks(const TSwaitshared *shared)
+{
+		return tsAtomicLoad_u32(&shared->kind, TS_RELAXED) == TS_WAIT_PARK;
+}
+
+/// Define "Name", pipe "Pipe" (of "type" elements, from "TS_PIPE_DEFINE" or
+/// "TS_PIPE_DEFINE_INTERLEAVED" with prefix "pipePrefix") that readers can wait on.
+/// "prefix##ReaderReadBack" waits, following the pipe's wait strategy, until it has read
+/// an element or the pipe was closed with "prefix##Close". With "TS_WAIT_PARK" (the
+/// default, "tsWaitPark(TS_PIPE_WAIT_SPIN_COUNT, TS_WAIT_FOREVER)") every function that
+/// publishes elements, "prefix##WriterTryWriteFront", "prefix##WriterTryWriteFrontN" and
+/// "prefix##WriterCommitFront", wakes sleeping readers. Every other function of "Pipe" is
+/// wrapped as is. Writing through "pipePrefix##*" on "pipe" directly wakes nobody.
+#define TS_PIPE_DEFINE_BLOCKING(Name, prefix, Pipe, pipePrefix, type) \
+		struct Name \
+		{ \
+				Pipe pipe; \
+				TSeventcount event; \
+				TSwaitshared wait; \
+				uint32_t volatile closed; \
+		}; \
+		typedef struct Name Name; \
+		static inline void prefix##Init(Name *pipe) \
+		{ \
+				pipePrefix##Init(&pipe->pipe); \
+				tsEventCountInit(&pipe->event); \
+				tsWaitSharedInit(&pipe->wait, tsWaitPark(TS_PIPE_WAIT_SPIN_COUNT, TS_WAIT_FOREVER)); \
+				pipe->closed = 0; \
+		} \
+		/* Readers already waiting or about to switch over too. A write racing the switch to \
+		   "TS_WAIT_PARK" may not wake a reader parking meanwhile, it wakes up with the next \
+		   write. */ \
+		static inline void prefix##SetWaitStrategy(Name *pipe, TSwaitstrategy strategy) \
+		{ \
+				tsWaitSharedStore(&pipe->wait, strategy); \
+				tsEventCountNotifyAll(&pipe->event); \
+		} \
+		/* No thread may use the pipe any more. */ \
+		static inline void prefix##Destroy(Name *pipe) \
+		{ \
+				tsEventCountDestroy(&pipe->event); \
+		} \
+		/* Wake every sleeping reader, "prefix##ReaderReadBack" fails once the pipe is empty. */ \
+		static inline void prefix##Close(Name *pipe) \
+		{ \
+				tsAtomicStore_u32(&pipe->closed, 1, TS_RELEASE); \
+				tsEventCountNotifyAll(&pipe->event); \
+		} \
+		static inline int prefix##IsEmpty(Name *pipe) \
+		{ \
+				return pipePrefix##IsEmpty(&pipe->pipe); \
+		} \
+		static inline int prefix##ReaderTryReadBack(Name *pipe, type *out) \
+		{ \
+				return pipePrefix##ReaderTryReadBack(&pipe->pipe, out); \
+		} \
+		static inline uint32_t prefix##ReaderTryReadBackHalf(Name *pipe, type *out, uint32_t n) \
+		{ \
+				return pipePrefix##ReaderTryReadBackHalf(&pipe->pipe, out, n); \
+		} \
+		/* Return 0 only if the pipe was closed and nothing is left to read. */ \
+		static inline int prefix##ReaderReadBack(Name *pipe, type *out) \
+		{ \
+				uint32_t failures = 0; \
+				TSwaitstrategy wait; \
+				uint32_t waitSeq = tsWaitSharedLoad(&pipe->wait, &wait); \
+				while (1) \
+				{ \
+						if (pipePrefix##ReaderTryReadBack(&pipe->pipe, out)) return 1; \
+						if (tsAtomicLoad_u32(&pipe->closed, TS_ACQUIRE)) \
+						{ \
+								return pipePrefix##ReaderTryReadBack(&pipe->pipe, out); \
+						} \
+						if (tsWaitSharedChanged(&pipe->wait, waitSeq)) \
+						{ \
+								waitSeq = tsWaitSharedLoad(&pipe->wait, &wait); \
+								failures = 0; \
+						} \
+						if (!tsWaitStrategyIdle(&wait, &failures)) continue; \
+						uint32_t key = tsEventCountPrepareWait(&pipe->event); \
+						/* Writers notify only while the strategy parks. Either we see a switch since \
+						   our copy, or "prefix##SetWaitStrategy" sees us waiting and wakes us. */ \
+						if (tsWaitSharedChanged(&pipe->wait, waitSeq)) \
+						{ \
+								tsEventCountCancelWait(&pipe->event); \
+								continue; \
+						} \
+						if (pipePrefix##ReaderTryReadBack(&pipe->pipe, out)) \
+						{ \
+								tsEventCountCancelWait(&pipe->event); \
+								return 1; \
+						} \
+						if (tsAtomicLoad_u32(&pipe->closed, TS_ACQUIRE)) \
+						{ \
+								tsEventCountCancelWait(&pipe->event); \
+								return pipePrefix##ReaderTryReadBack(&pipe->pipe, out); \
+						} \
+						TS_TRACE_EVENT_(TS_TRACE_PARK, 0); \
+						tsEventCountWait(&pipe->event, key, wait.parkTimeoutNs); \
+						TS_TRACE_EVENT_(TS_TRACE_UNPARK, 0); \
+				} \
+		} \
+		static inline int prefix##WriterTryReadFront(Name *pipe, type *out) \
+		{ \
+				return pipePrefix##WriterTryReadFront(&pipe->pipe, out); \
+		} \
+		static inline int prefix##WriterTryWriteFront(Name *pipe, type *in) \
+		{ \
+				if (!pipePrefix##WriterTryWriteFront(&pipe->pipe, in)) return 0; \
+				/* Only parking readers need waking, the others do not cost us a fence. */ \
+				if (tsWaitSharedParks(&pipe->wait)) tsEventCountNotifyOne(&pipe->event); \
+				return 1; \
+		} \
+		/* More than one element is enough for more than one reader, wake them all. */ \
+		static inline uint32_t prefix##WriterTryWriteFrontN(Name *pipe, type *items, uint32_t n) \
+		{ \
+				uint32_t written = pipePrefix##WriterTryWriteFrontN(&pipe->pipe, items, n); \
+				if (written == 0 || !tsWaitSharedParks(&pipe->wait)) return written; \
+				if (written == 1) tsEventCountNotifyOne(&pipe->event); \
+				else tsEventCountNotifyAll(&pipe->event); \
+				return written; \
+		} \
+		static inline type *prefix##WriterReserveFront(Name *pipe) \
+		{ \
+				return pipePrefix##WriterReserveFront(&pipe->pipe); \
+		} \
+		static inline void prefix##WriterCommitFront(Name *pipe) \
+		{ \
+				pipePrefix##WriterCommitFront(&pipe->pipe); \
+				if (tsWaitSharedParks(&pipe->wait)) tsEventCountNotifyOne(&pipe->event); \
+		} \
+		static inline const type *prefix##ReaderClaimBack(Name *pipe, uint32_t *slot) \
+		{ \
+				return pipePrefix##ReaderClaimBack(&pipe->pipe, slot); \
+		} \
+		static inline int prefix##ReaderClaimExpired(Name *pipe, uint32_t slot) \
+		{ \
+				return pipePrefix##ReaderClaimExpired(&pipe->pipe, slot); \
+		} \
+		static inline void prefix##ReaderReleaseBack(Name *pipe, uint32_t slot) \
+		{ \
+				pipePrefix##ReaderReleaseBack(&pipe->pipe, slot); \
+		} \
+		static inline void prefix##ReaderDetachBack(Name *pipe, uint32_t slot, type *out) \
+		{ \
+				pipePrefix##ReaderDetachBack(&pipe->pipe, slot, out); \
+		} \
+		static inline void prefix##SetClaimSlack(Name *pipe, uint32_t slack) \
+		{ \
+				pipePrefix##SetClaimSlack(&pipe->pipe, slack); \
+		}
+
+/// The default blocking pipe, a "TSpipe" readers can sleep on.
+TS_PIPE_DEFINE_BLOCKING(TSblockingpipe, tsBlockingPipe, TSpipe, tsPipe, TSpipedata)
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif // PIPE_WAIT_H
@@ -0,0 +1,123 @@
+// "TSchainpipe" under a writer and 3 readers: blocks of 16 elements, bursts that grow the
+// chain by several blocks, pauses that let readers drain it so later bursts reuse the
+// unlinked blocks, and the writer popping its newest element now and then. Every element
+// must come out exactly once, and the chain must have reused blocks instead of allocating
+// one per 16 elements. Once a far larger burst is drained, the writer frees its blocks.
+
+#include <sched.h>
+
+#include "./test.h"
+#include "../pipe_chain.h"
+
+enum
+{
+		TEST_BLOCK_SIZE_LOG2 = 4,
+		TEST_READERS = 3,
+		TEST_ELEMENTS = 400000,
+		TEST_BURST = 200,
+		TEST_PEAK_BLOCKS = 256
+};
+
+TS_CHAINPIPE_DEFINE(TestChain, testChain, uint32_t)
+
+static TestChain testPipe;
+static uint8_t volatile *testSeen;
+static uint32_t volatile testDone;
+
+static void
+testTake(uint32_t value)
+{
+		if (value == 0 || value > TEST_ELEMENTS) TS_TEST_CHECK(!"value out of range");
+		else __atomic_fetch_add(&testSeen[value], 1, __ATOMIC_RELAXED);
+}
+
+/// Blocks the chain has allocated and not freed yet.
+static uint32_t
+testBlocks(TestChain *pipe)
+{
+		uint32_t blocks = 0;
+		for (TSchainblock *block = pipe->chain.retired; block; block = block->next) ++blocks;
+		return blocks;
+}
+
+static void *
+testReader(void *arg)
+{
+		uint32_t value;
+		(void)arg;
+		while (1)
+		{
+				if (testChainReaderTryReadBack(&testPipe, &value))
+				{
+						testTake(value);
+						continue;
+				}
+				if (tsAtomicLoad_u32(&testDone, TS_ACQUIRE) && testChainIsEmpty(&testPipe)) break;
+				sched_yield();
+		}
+		return NULL;
+}
+
+int
+main(void)
+{
+		pthread_t readers[TEST_READERS];
+		testSeen = (uint8_t volatile *)calloc(TEST_ELEMENTS + 1, 1);
+		TS_TEST_CHECK(testChainInit(&testPipe, TEST_BLOCK_SIZE_LOG2));
+		for (uintptr_t i = 0; i < TEST_READERS; ++i)
+		{
+				pthread_create(&readers[i], NULL, testReader, (void *)i);
+		}
+
+		for (uint32_t value = 1; value <= TEST_ELEMENTS; ++value)
+		{
+				TS_TEST_CHECK(testChainWriterTryWriteFront(&testPipe, &value));
+
+				uint32_t popped;
+				if (value % 7 == 0 && testChainWriterTryReadFront(&testPipe, &popped))
+				{
+						testTake(popped);
+				}
+
+				// Let the readers catch up after every burst, the next one reuses drained blocks.
+				if (value % TEST_BURST == 0)
+				{
+						for (uint32_t i = 0; i < 64 && !testChainIsEmpty(&testPipe); ++i) sched_yield();
+				}
+		}
+		tsAtomicStore_u32(&testDone, 1, TS_RELEASE);
+		for (uint32_t i = 0; i < TEST_READERS; ++i) pthread_join(readers[i], NULL);
+
+		uint32_t lost = 0, duplicated = 0;
+		for (uint32_t value = 1; value <= TEST_ELEMENTS; ++value)
+		{
+				lost += testSeen[value] == 0;
+				duplicated += testSeen[value] > 1;
+		}
+		TS_TEST_CHECK(lost == 0);
+		TS_TEST_CHECK(duplicated == 0);
+
+		// Every block still allocated is on the list starting at "retired".
+		uint32_t blocks = testBlocks(&testPipe);
+		TS_TEST_CHECK(blocks > 2);
+		TS_TEST_CHECK(blocks < (TEST_ELEMENTS >> TEST_BLOCK_SIZE_LOG2) / 8);
+		printf("%u lost, %u duplicated, %u blocks allocated\n", lost, duplicated, blocks);
+
+		// A burst far larger than the usual backlog, drained. With no reader about, one
+		// reclaim frees every block but the writer's and the spares.
+		for (uint32_t value = 0; value < TEST_PEAK_BLOCKS << TEST_BLOCK_SIZE_LOG2; ++value)
+		{
+				TS_TEST_CHECK(testChainWriterTryWriteFront(&testPipe, &value));
+		}
+		TS_TEST_CHECK(testBlocks(&testPipe) >= TEST_PEAK_BLOCKS);
+		uint32_t expected = 0, value;
+		while (testChainReaderTryReadBack(&testPipe, &value)) TS_TEST_CHECK(value == expected++);
+		TS_TEST_CHECK(expected == TEST_PEAK_BLOCKS << TEST_BLOCK_SIZE_LOG2);
+		testChainWriterReclaim(&testPipe);
+		TS_TEST_CHECK(testBlocks(&testPipe) <= TS_CHAIN_SPARE_BLOCKS + 1);
+
+		testChainDestroy(&testPipe);
+		TS_TEST_CHECK(testPipe.chain.head == NULL && testPipe.chain.retired == NULL);
+		free((void *)testSeen);
+		return tsTestResult("chain");
+}
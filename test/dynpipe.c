@@ -0,0 +1,102 @@
+// "TS_PIPE_DEFINE_DYNAMIC": storage allocated by the pipe or supplied by the caller, sizes
+// it must refuse, and the pipe running full and empty again over many laps from both ends.
+
+#include "./test.h"
+#include "../pipe.h"
+
+TS_PIPE_DEFINE_DYNAMIC(TestDynPipe, testDynPipe, uint32_t)
+
+/// Fill the pipe until it is full and empty it again, "laps" times, taking elements from
+/// the back and the front in turn. The elements must come out in order from either end.
+static void
+testLaps(TestDynPipe *pipe, uint32_t laps)
+{
+		uint32_t capacity = testDynPipeCapacity(pipe);
+		uint32_t next = 0;
+		for (uint32_t lap = 0; lap < laps; ++lap)
+		{
+				TS_TEST_CHECK(testDynPipeIsEmpty(pipe));
+				uint32_t first = next;
+				for (uint32_t i = 0; i < capacity; ++i, ++next)
+				{
+						TS_TEST_CHECK(testDynPipeWriterTryWriteFront(pipe, &next));
+				}
+				uint32_t extra = next;
+				TS_TEST_CHECK(!testDynPipeWriterTryWriteFront(pipe, &extra));
+				TS_TEST_CHECK(!testDynPipeIsEmpty(pipe));
+
+				uint32_t back = first, front = next;
+				for (uint32_t i = 0; i < capacity; ++i)
+				{
+						uint32_t value = UINT32_MAX;
+						if (i & 1)
+						{
+								TS_TEST_CHECK(testDynPipeWriterTryReadFront(pipe, &value));
+								TS_TEST_CHECK(value == --front);
+						}
+						else
+						{
+								TS_TEST_CHECK(testDynPipeReaderTryReadBack(pipe, &value));
+								TS_TEST_CHECK(value == back++);
+						}
+				}
+				uint32_t value;
+				TS_TEST_CHECK(!testDynPipeReaderTryReadBack(pipe, &value));
+				TS_TEST_CHECK(!testDynPipeWriterTryReadFront(pipe, &value));
+		}
+		TS_TEST_CHECK(testDynPipeIsEmpty(pipe));
+}
+
+int
+main(void)
+{
+		TestDynPipe pipe;
+
+		// Storage allocated by the pipe.
+		TS_TEST_CHECK(testDynPipeInit(&pipe, 3, NULL, NULL));
+		TS_TEST_CHECK(testDynPipeCapacity(&pipe) == 8);
+		TS_TEST_CHECK(pipe.owns == (TS_DYNPIPE_OWNS_BUFFER | TS_DYNPIPE_OWNS_FLAGS));
+		testLaps(&pipe, 5);
+		testDynPipeDestroy(&pipe);
+		TS_TEST_CHECK(pipe.buffer == NULL && pipe.flags == NULL && pipe.owns == 0);
+
+		// Storage of the caller, flags full of garbage that "Init" has to clear.
+		uint32_t buffer[16];
+		TSpipeflag flags[16];
+		memset(flags, 0xFF, sizeof(flags));
+		TS_TEST_CHECK(testDynPipeInit(&pipe, 4, buffer, flags));
+		TS_TEST_CHECK(testDynPipeCapacity(&pipe) == 16);
+		TS_TEST_CHECK(pipe.owns == 0);
+		TS_TEST_CHECK(pipe.buffer == buffer && pipe.flags == flags);
+		testLaps(&pipe, 5);
+		testDynPipeDestroy(&pipe);
+
+		// Caller buffer, flags allocated.
+		TS_TEST_CHECK(testDynPipeInit(&pipe, 4, buffer, NULL));
+		TS_TEST_CHECK(pipe.owns == TS_DYNPIPE_OWNS_FLAGS);
+		testLaps(&pipe, 3);
+		testDynPipeDestroy(&pipe);
+
+		// A single element.
+		TS_TEST_CHECK(testDynPipeInit(&pipe, 0, NULL, NULL));
+		TS_TEST_CHECK(testDynPipeCapacity(&pipe) == 1);
+		testLaps(&pipe, 3);
+		testDynPipeDestroy(&pipe);
+
+		// The indices are 32 bits, larger pipes are refused before allocating anything.
+		TS_TEST_CHECK(!testDynPipeInit(&pipe, 32, NULL, NULL));
+		TS_TEST_CHECK(!testDynPipeInit(&pipe, 40, buffer, flags));
+
+		// The default one.
+		TSdynpipe dynpipe;
+		TSpipedata data, out;
+		memset(&data, 0x5A, sizeof(data));
+		memset(&out, 0, sizeof(out));
+		TS_TEST_CHECK(tsDynPipeInit(&dynpipe, 2, NULL, NULL));
+		TS_TEST_CHECK(tsDynPipeWriterTryWriteFront(&dynpipe, &data));
+		TS_TEST_CHECK(tsDynPipeReaderTryReadBack(&dynpipe, &out));
+		TS_TEST_CHECK(memcmp(&out, &data, sizeof(data)) == 0);
+		tsDynPipeDestroy(&dynpipe);
+
+		return tsTestResult("dynpipe");
+}
@@ -0,0 +1,159 @@
+// "ts::Pipe" with a move-only payload: "std::unique_ptr" goes in and comes out again through
+// push, pop and steal, first on one thread to check the order and the full / empty cases,
+// then with an owner and 3 thieves. Every element must come out exactly once and every
+// payload must be destroyed, the ones left in the pipe by its destructor.
+
+#include <sched.h>
+
+#include <memory>
+
+#include "./test.h"
+#include "../pipe.hpp"
+
+enum
+{
+		TEST_READERS = 3,
+		TEST_ELEMENTS = 200000
+};
+
+/// Payload counting how many of its kind are alive.
+struct TestItem
+{
+		explicit TestItem(uint32_t value) noexcept : value(value)
+		{
+				__atomic_fetch_add(&alive, 1, __ATOMIC_RELAXED);
+		}
+
+		~TestItem() { __atomic_fetch_sub(&alive, 1, __ATOMIC_RELAXED); }
+
+		uint32_t value;
+
+		static int32_t alive;
+};
+
+int32_t TestItem::alive;
+
+typedef std::unique_ptr<TestItem> TestPtr;
+
+static ts::Pipe<TestPtr, 16> testPipe;
+static uint8_t volatile *testSeen;
+static uint32_t volatile testDone;
+
+static void
+testTake(const TestPtr &item)
+{
+		if (!item || item->value == 0 || item->value > TEST_ELEMENTS)
+		{
+				TS_TEST_CHECK(!"item out of range");
+		}
+		else __atomic_fetch_add(&testSeen[item->value], 1, __ATOMIC_RELAXED);
+}
+
+static void
+testOneThread(void)
+{
+		ts::Pipe<TestPtr, 4> pipe;
+		TS_TEST_CHECK(pipe.empty());
+		TS_TEST_CHECK(!pipe.try_pop());
+		TS_TEST_CHECK(!pipe.try_steal());
+
+		for (uint32_t value = 1; value <= 4; ++value)
+		{
+				TestPtr item(new TestItem(value));
+				TS_TEST_CHECK(pipe.try_push(std::move(item)));
+				TS_TEST_CHECK(!item);
+		}
+
+		// Full: the element must be left alone.
+		TestPtr extra(new TestItem(5));
+		TS_TEST_CHECK(!pipe.try_push(std::move(extra)));
+		TS_TEST_CHECK(extra && extra->value == 5);
+		TS_TEST_CHECK(!pipe.try_emplace(nullptr));
+		TS_TEST_CHECK(TestItem::alive == 5);
+		delete extra.release();
+
+		// Oldest from the back, newest from the front.
+		std::optional<TestPtr> item = pipe.try_steal();
+		TS_TEST_CHECK(item && (*item)->value == 1);
+		item = pipe.try_pop();
+		TS_TEST_CHECK(item && (*item)->value == 4);
+		item.reset();
+
+		// Wrap around, then leave two for the destructor.
+		TS_TEST_CHECK(pipe.try_emplace(new TestItem(7)));
+		TS_TEST_CHECK(pipe.try_emplace(new TestItem(8)));
+		item = pipe.try_steal();
+		TS_TEST_CHECK(item && (*item)->value == 2);
+		item = pipe.try_steal();
+		TS_TEST_CHECK(item && (*item)->value == 3);
+		item.reset();
+		TS_TEST_CHECK(!pipe.empty());
+}
+
+static void *
+testReader(void *arg)
+{
+		(void)arg;
+		while (1)
+		{
+				if (std::optional<TestPtr> item = testPipe.try_steal())
+				{
+						testTake(*item);
+						continue;
+				}
+				if (tsAtomicLoad_u32(&testDone, TS_ACQUIRE) && testPipe.empty()) break;
+				sched_yield();
+		}
+		return NULL;
+}
+
+static void
+testThreads(void)
+{
+		pthread_t readers[TEST_READERS];
+		testSeen = (uint8_t volatile *)calloc(TEST_ELEMENTS + 1, 1);
+		for (uintptr_t i = 0; i < TEST_READERS; ++i)
+		{
+				pthread_create(&readers[i], NULL, testReader, (void *)i);
+		}
+
+		for (uint32_t value = 1; value <= TEST_ELEMENTS;)
+		{
+				TestPtr item(new TestItem(value));
+				if (!testPipe.try_push(std::move(item)))
+				{
+						sched_yield();
+						continue;
+				}
+				if (value % 5 == 0)
+				{
+						if (std::optional<TestPtr> popped = testPipe.try_pop()) testTake(*popped);
+				}
+				++value;
+		}
+
+		tsAtomicStore_u32(&testDone, 1, TS_RELEASE);
+		for (uint32_t i = 0; i < TEST_READERS; ++i) pthread_join(readers[i], NULL);
+		TS_TEST_CHECK(testPipe.empty());
+
+		uint32_t lost = 0, duplicated = 0;
+		for (uint32_t value = 1; value <= TEST_ELEMENTS; ++value)
+		{
+				lost += testSeen[value] == 0;
+				duplicated += testSeen[value] > 1;
+		}
+		TS_TEST_CHECK(lost == 0);
+		TS_TEST_CHECK(duplicated == 0);
+		printf("%u lost, %u duplicated\n", lost, duplicated);
+		free((void *)testSeen);
+}
+
+int
+main(void)
+{
+		testOneThread();
+		TS_TEST_CHECK(TestItem::alive == 0);
+		testThreads();
+		TS_TEST_CHECK(TestItem::alive == 0);
+		return tsTestResult("hpp");
+}
@@ -0,0 +1,145 @@
+// "TSscheduler": tasks spawning tasks and waiting for them, shutdown with tasks still
+// queued, every item of "tsSchedulerParallelFor" visited exactly once, and idle workers
+// going to sleep, on 1 to 4 workers and on one per core.
+
+#include "./test.h"
+#include "../pipe_sched.h"
+
+struct TestTree
+{
+		TSscheduler *sched;
+		uint32_t depth;
+};
+
+static uint64_t volatile testLeaves;
+
+/// Spawn two subtrees and wait for them, a leaf counts itself.
+static void
+testTree(void *arg)
+{
+		struct TestTree *tree = (struct TestTree *)arg;
+		if (tree->depth == 0)
+		{
+				__atomic_fetch_add(&testLeaves, 1, __ATOMIC_RELAXED);
+				return;
+		}
+
+		TScounter counter = {0};
+		struct TestTree left = {tree->sched, tree->depth - 1};
+		struct TestTree right = {tree->sched, tree->depth - 1};
+		tsSchedulerSpawn(tree->sched, testTree, &left, &counter);
+		tsSchedulerSpawn(tree->sched, testTree, &right, &counter);
+		tsSchedulerWait(tree->sched, &counter);
+		TS_TEST_CHECK(tsAtomicLoad_u32(&counter.count, TS_RELAXED) == 0);
+}
+
+static TSscheduler *testSched;
+static uint64_t volatile testRan;
+
+/// Count itself, and spawn "arg" more tasks like it without waiting for them.
+static void
+testDetached(void *arg)
+{
+		uintptr_t children = (uintptr_t)arg;
+		__atomic_fetch_add(&testRan, 1, __ATOMIC_RELAXED);
+		for (uintptr_t i = 0; i < children; ++i)
+		{
+				tsSchedulerSpawn(testSched, testDetached, (void *)(uintptr_t)0, NULL);
+		}
+}
+
+struct TestLoop
+{
+		uint32_t volatile *visits;
+		uint64_t volatile calls;
+};
+
+static void
+testLoopBody(void *ctx, uint64_t begin, uint64_t end)
+{
+		struct TestLoop *loop = (struct TestLoop *)ctx;
+		TS_TEST_CHECK(begin < end);
+		__atomic_fetch_add(&loop->calls, 1, __ATOMIC_RELAXED);
+		for (uint64_t i = begin; i < end; ++i)
+		{
+				tsAtomicFetchAdd_u32(&loop->visits[i], 1, TS_RELAXED);
+		}
+}
+
+/// Return 1 once every worker of "sched" sleeps, 0 if they did not within 5 seconds.
+static int
+testAllAsleep(TSscheduler *sched)
+{
+		for (uint32_t waited = 0; waited < 5000; ++waited)
+		{
+				if (tsAtomicLoad_u32(&sched->idle.waiters, TS_ACQUIRE) == sched->numWorkers) return 1;
+				struct timespec nap = {0, 1000000};
+				nanosleep(&nap, NULL);
+		}
+		return 0;
+}
+
+static void
+testRun(uint32_t workers)
+{
+		TSscheduler sched;
+		TS_TEST_CHECK(tsSchedulerInit(&sched, workers));
+		TS_TEST_CHECK(sched.numWorkers == (workers ? workers : tsSchedNumCores()));
+		testSched = &sched;
+		TS_TEST_CHECK(testAllAsleep(&sched));
+
+		// Nested spawns, from outside the pool at the root and from workers below it.
+		TScounter counter = {0};
+		struct TestTree tree = {&sched, 12};
+		testLeaves = 0;
+		tsSchedulerSpawn(&sched, testTree, &tree, &counter);
+		tsSchedulerWait(&sched, &counter);
+		TS_TEST_CHECK(testLeaves == 1u << 12);
+		TS_TEST_CHECK(testAllAsleep(&sched));
+
+		// Every item once, for sizes around the grain and ranges not starting at 0.
+		static const uint64_t sizes[] = {0, 1, TS_SCHED_FOR_GRAIN - 1, TS_SCHED_FOR_GRAIN,
+		    TS_SCHED_FOR_GRAIN + 1, 1000, 100003};
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+		{
+				uint64_t offset = s * 7;
+				struct TestLoop loop;
+				loop.visits = (uint32_t volatile *)calloc(sizes[s] + offset + 1, sizeof(uint32_t));
+				loop.calls = 0;
+				tsSchedulerParallelFor(&sched, offset, offset + sizes[s], testLoopBody, &loop);
+
+				uint64_t wrong = 0;
+				for (uint64_t i = 0; i < sizes[s] + offset + 1; ++i)
+				{
+						wrong += loop.visits[i] != (i >= offset && i < offset + sizes[s]);
+				}
+				TS_TEST_CHECK(wrong == 0);
+				TS_TEST_CHECK(loop.calls >= (sizes[s] + TS_SCHED_FOR_GRAIN - 1) / TS_SCHED_FOR_GRAIN);
+				free((void *)loop.visits);
+		}
+
+		// Shutdown with tasks still queued, some of which spawn more while it drains them.
+		const uintptr_t tasks = 2000;
+		testRan = 0;
+		for (uintptr_t i = 0; i < tasks; ++i)
+		{
+				tsSchedulerSpawn(&sched, testDetached, (void *)(uintptr_t)(i & 3), NULL);
+		}
+		tsSchedulerDestroy(&sched);
+		uint64_t expected = tasks + (tasks / 4) * (0 + 1 + 2 + 3);
+		TS_TEST_CHECK(testRan == expected);
+		if (testRan != expected)
+		{
+				fprintf(stderr, "%u workers: %llu of %llu tasks ran\n", workers,
+				    (unsigned long long)testRan, (unsigned long long)expected);
+		}
+}
+
+int
+main(void)
+{
+		for (uint32_t workers = 1; workers <= 4; workers *= 2) testRun(workers);
+		// 0 is one worker per core.
+		testRun(0);
+		return tsTestResult("sched");
+}
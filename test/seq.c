@@ -0,0 +1,93 @@
+// "TSseqpipe" under a writer and 3 readers, with a small pipe so that it wraps around and
+// runs full all the time, and the writer popping its newest element now and then, racing
+// the readers for the last one. Every element must come out exactly once.
+
+#include <sched.h>
+
+#include "./test.h"
+#include "../pipe_seq.h"
+
+enum
+{
+		TEST_SIZE_LOG2 = 4,
+		TEST_READERS = 3,
+		TEST_ELEMENTS = 1000000
+};
+
+TS_SEQPIPE_DEFINE(TestSeqPipe, testSeqPipe, uint32_t, TEST_SIZE_LOG2)
+
+static TestSeqPipe testPipe;
+static uint8_t volatile *testSeen;
+static uint32_t volatile testDone;
+
+static void
+testTake(uint32_t value)
+{
+		if (value == 0 || value > TEST_ELEMENTS) TS_TEST_CHECK(!"value out of range");
+		else __atomic_fetch_add(&testSeen[value], 1, __ATOMIC_RELAXED);
+}
+
+static void *
+testReader(void *arg)
+{
+		uint32_t value;
+		(void)arg;
+		while (1)
+		{
+				if (testSeqPipeReaderTryReadBack(&testPipe, &value))
+				{
+						testTake(value);
+						continue;
+				}
+				if (tsAtomicLoad_u32(&testDone, TS_ACQUIRE) && testSeqPipeIsEmpty(&testPipe)) break;
+				sched_yield();
+		}
+		return NULL;
+}
+
+int
+main(void)
+{
+		pthread_t readers[TEST_READERS];
+		testSeen = (uint8_t volatile *)calloc(TEST_ELEMENTS + 1, 1);
+		testSeqPipeInit(&testPipe);
+		for (uintptr_t i = 0; i < TEST_READERS; ++i)
+		{
+				pthread_create(&readers[i], NULL, testReader, (void *)i);
+		}
+
+		for (uint32_t value = 1; value <= TEST_ELEMENTS;)
+		{
+				uint32_t popped;
+				if (!testSeqPipeWriterTryWriteFront(&testPipe, &value))
+				{
+						sched_yield();
+						continue;
+				}
+				if (value % 5 == 0 && testSeqPipeWriterTryReadFront(&testPipe, &popped))
+				{
+						testTake(popped);
+				}
+				++value;
+		}
+
+		// What the readers leave once we are done, the writer takes back from the front.
+		uint32_t popped;
+		while (testSeqPipeWriterTryReadFront(&testPipe, &popped)) testTake(popped);
+		tsAtomicStore_u32(&testDone, 1, TS_RELEASE);
+		for (uint32_t i = 0; i < TEST_READERS; ++i) pthread_join(readers[i], NULL);
+		TS_TEST_CHECK(testSeqPipeIsEmpty(&testPipe));
+
+		uint32_t lost = 0, duplicated = 0;
+		for (uint32_t value = 1; value <= TEST_ELEMENTS; ++value)
+		{
+				lost += testSeen[value] == 0;
+				duplicated += testSeen[value] > 1;
+		}
+		TS_TEST_CHECK(lost == 0);
+		TS_TEST_CHECK(duplicated == 0);
+		printf("%u lost, %u duplicated\n", lost, duplicated);
+
+		free((void *)testSeen);
+		return tsTestResult("seq");
+}
@@ -0,0 +1,35 @@
+#ifndef PIPE_TEST_H
+#define PIPE_TEST_H
+
+// Helpers shared by the tests. A failed check prints where it was and the test goes on, its
+// exit status is 1 if any failed.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int tsTestFailures;
+
+/// Report "cond" at this line if it does not hold, and count the failure.
+#define TS_TEST_CHECK(cond) \
+		do \
+		{ \
+				if (!(cond)) \
+				{ \
+						fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+						++tsTestFailures; \
+				} \
+		} while (0)
+
+/// Exit status of the test, print a summary.
+static inline int
+tsTestResult(const char *name)
+{
+		if (tsTestFailures) fprintf(stderr, "%s: %d checks failed\n", name, tsTestFailures);
+		else printf("%s: ok\n", name);
+		return tsTestFailures ? 1 : 0;
+}
+
+#endif // PIPE_TEST_H
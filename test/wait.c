@@ -0,0 +1,207 @@
+// "TS_PIPE_DEFINE_BLOCKING": readers parked without a timeout must be woken by every way
+// the writer publishes, one element, a batch or a reserved slot, and by "Close". Readers
+// keep reading while another thread switches the wait strategy under them, and a reader
+// about to park must not sleep for good when the pipe stops parking. The wrapped claim and
+// batched read functions go through the same pipe.
+
+#include <sched.h>
+
+#include "./test.h"
+#include "../pipe_wait.h"
+
+enum
+{
+		TEST_READERS = 3,
+		TEST_ROUNDS = 50,
+		TEST_BATCH = 4,
+		TEST_SWITCHED = 20000,
+		TEST_UNPARKS = 300,
+		TEST_DEADLINE_MS = 5000
+};
+
+TS_PIPE_DEFINE(TestPipe, testPipe, uint32_t, 4)
+TS_PIPE_DEFINE_BLOCKING(TestBlockingPipe, testBlockingPipe, TestPipe, testPipe, uint32_t)
+
+static TestBlockingPipe testPipe;
+static uint32_t volatile testRead;
+static uint32_t volatile testSwitching;
+
+static void *
+testReader(void *arg)
+{
+		uint32_t value;
+		(void)arg;
+		while (testBlockingPipeReaderReadBack(&testPipe, &value))
+		{
+				tsAtomicFetchAdd_u32(&testRead, 1, TS_RELEASE);
+		}
+		return NULL;
+}
+
+/// Switch between wait strategies until told to stop, none that spins as the test may have
+/// a single core. Parking readers may miss a wake-up racing the switch, so they do not
+/// sleep for long.
+static void *
+testSwitcher(void *arg)
+{
+		(void)arg;
+		TSwaitstrategy strategies[4] = {
+		    tsWaitYield(), tsWaitPark(8, 1000000), tsWaitYield(), tsWaitPark(0, 2000000)};
+		for (uint32_t i = 0; tsAtomicLoad_u32(&testSwitching, TS_ACQUIRE); ++i)
+		{
+				testBlockingPipeSetWaitStrategy(&testPipe, strategies[i % 4]);
+				sched_yield();
+		}
+		return NULL;
+}
+
+static uint64_t
+testNowMs(void)
+{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/// Wait until "sleepers" readers sleep and "count" elements have been read. Return 0 if it
+/// did not happen in time.
+static int
+testWaitFor(uint32_t sleepers, uint32_t count)
+{
+		uint64_t deadline = testNowMs() + TEST_DEADLINE_MS;
+		while (tsAtomicLoad_u32(&testPipe.event.waiters, TS_ACQUIRE) != sleepers ||
+		    tsAtomicLoad_u32(&testRead, TS_ACQUIRE) != count)
+		{
+				if (testNowMs() > deadline) return 0;
+				sched_yield();
+		}
+		return 1;
+}
+
+int
+main(void)
+{
+		pthread_t readers[TEST_READERS];
+		testBlockingPipeInit(&testPipe);
+		testBlockingPipeSetWaitStrategy(&testPipe, tsWaitPark(0, TS_WAIT_FOREVER));
+		for (uintptr_t i = 0; i < TEST_READERS; ++i)
+		{
+				pthread_create(&readers[i], NULL, testReader, (void *)i);
+		}
+
+		// Every round starts with all readers asleep, so only a notification gets the element
+		// read. Nothing else would ever wake them.
+		uint32_t written = 0;
+		for (uint32_t round = 0; round < TEST_ROUNDS; ++round)
+		{
+				if (!testWaitFor(TEST_READERS, written))
+				{
+						TS_TEST_CHECK(!"readers were not woken");
+						break;
+				}
+				uint32_t value = round;
+				switch (round % 3)
+				{
+						case 0:
+								TS_TEST_CHECK(testBlockingPipeWriterTryWriteFront(&testPipe, &value));
+								written += 1;
+								break;
+						case 1:
+						{
+								uint32_t batch[TEST_BATCH] = {value, value, value, value};
+								TS_TEST_CHECK(
+								    testBlockingPipeWriterTryWriteFrontN(&testPipe, batch, TEST_BATCH) ==
+								    TEST_BATCH);
+								written += TEST_BATCH;
+								break;
+						}
+						case 2:
+						{
+								uint32_t *slot = testBlockingPipeWriterReserveFront(&testPipe);
+								TS_TEST_CHECK(slot != NULL);
+								if (!slot) break;
+								*slot = value;
+								testBlockingPipeWriterCommitFront(&testPipe);
+								written += 1;
+								break;
+						}
+				}
+		}
+		TS_TEST_CHECK(testWaitFor(TEST_READERS, written));
+
+		pthread_t switcher;
+		tsAtomicStore_u32(&testSwitching, 1, TS_RELEASE);
+		pthread_create(&switcher, NULL, testSwitcher, NULL);
+		for (uint32_t value = 0; value < TEST_SWITCHED;)
+		{
+				if (testBlockingPipeWriterTryWriteFront(&testPipe, &value)) ++value;
+				else sched_yield();
+		}
+		written += TEST_SWITCHED;
+		uint64_t deadline = testNowMs() + TEST_DEADLINE_MS;
+		while (tsAtomicLoad_u32(&testRead, TS_ACQUIRE) != written && testNowMs() < deadline)
+		{
+				sched_yield();
+		}
+		tsAtomicStore_u32(&testSwitching, 0, TS_RELEASE);
+		pthread_join(switcher, NULL);
+		TS_TEST_CHECK(tsAtomicLoad_u32(&testRead, TS_ACQUIRE) == written);
+
+		testBlockingPipeClose(&testPipe);
+		for (uint32_t i = 0; i < TEST_READERS; ++i) pthread_join(readers[i], NULL);
+		TS_TEST_CHECK(testBlockingPipeIsEmpty(&testPipe));
+
+		// The wrapped reader functions, on their own now.
+		uint32_t batch[TEST_BATCH] = {1, 2, 3, 4};
+		uint32_t out[TEST_BATCH];
+		uint32_t slot;
+		TS_TEST_CHECK(testBlockingPipeWriterTryWriteFrontN(&testPipe, batch, TEST_BATCH) == 4);
+		const uint32_t *claimed = testBlockingPipeReaderClaimBack(&testPipe, &slot);
+		TS_TEST_CHECK(claimed && *claimed == 1);
+		if (claimed)
+		{
+				TS_TEST_CHECK(!testBlockingPipeReaderClaimExpired(&testPipe, slot));
+				testBlockingPipeReaderReleaseBack(&testPipe, slot);
+		}
+		claimed = testBlockingPipeReaderClaimBack(&testPipe, &slot);
+		TS_TEST_CHECK(claimed && *claimed == 2);
+		if (claimed)
+		{
+				testBlockingPipeReaderDetachBack(&testPipe, slot, &out[0]);
+				TS_TEST_CHECK(out[0] == 2);
+		}
+		TS_TEST_CHECK(testBlockingPipeReaderTryReadBackHalf(&testPipe, out, TEST_BATCH) >= 1);
+		TS_TEST_CHECK(out[0] == 3);
+
+		testBlockingPipeDestroy(&testPipe);
+
+		// Switch to spinning while the reader spends its last retries before parking. Writers
+		// stop notifying right away, so a reader that parks anyway would never see the element.
+		pthread_t reader;
+		testBlockingPipeInit(&testPipe);
+		tsAtomicStore_u32(&testRead, 0, TS_RELAXED);
+		pthread_create(&reader, NULL, testReader, NULL);
+		for (uint32_t i = 0; i < TEST_UNPARKS; ++i)
+		{
+				// Let the reader take up parking for a while, then switch.
+				struct timespec nap = {0, (long)(i % 4) * 100000};
+				testBlockingPipeSetWaitStrategy(&testPipe, tsWaitPark(i % 32, TS_WAIT_FOREVER));
+				nanosleep(&nap, NULL);
+				testBlockingPipeSetWaitStrategy(&testPipe, tsWaitSpin());
+
+				// Give the reader the time to park, if it is going to.
+				nap.tv_nsec = 200000;
+				nanosleep(&nap, NULL);
+				TS_TEST_CHECK(testBlockingPipeWriterTryWriteFront(&testPipe, &i));
+				if (!testWaitFor(0, i + 1))
+				{
+						TS_TEST_CHECK(!"reader parked after the switch to spinning");
+						break;
+				}
+		}
+		testBlockingPipeClose(&testPipe);
+		pthread_join(reader, NULL);
+		testBlockingPipeDestroy(&testPipe);
+
+		return tsTestResult("wait");
+}